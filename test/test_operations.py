@@ -21,6 +21,11 @@ import collections
 from common_utils import TestCase, run_tests, iter_indices
 import itertools
 import numpy
+import re
+import shutil
+import subprocess
+import tempfile
+import threading
 import torch
 import torch.nn as nn
 import torch.nn.functional as F
@@ -173,6 +178,20 @@ def _xla_run(model, input, device='TPU'):
     return output_xla[0]
 
 
+def _metric_samples(name):
+  report = torch_xla._XLAC._xla_metrics_report()
+  match = re.search(r'Metric: {}\n  TotalSamples: (\d+)'.format(name), report)
+  return int(match.group(1)) if match else 0
+
+
+def _run_with_env(test_name, **env):
+  # The settings read only once by the XLA client need a new process.
+  test_env = dict(os.environ)
+  test_env.update(env)
+  return subprocess.call(
+      [sys.executable, os.path.abspath(__file__), test_name], env=test_env)
+
+
 class XlaTestCase(TestCase):
 
   def assertEqualRel(self, out, expected, rel_err=1e-2, abs_err=1e-5):
@@ -758,6 +777,366 @@ class TestLongGraphChain(XlaTestCase):
     self.assertEqualRel(x, xla_x.to_tensor(), rel_err=1e-3, abs_err=5)
 
 
+class TestSharedGraphNodes(XlaTestCase):
+
+  def test(self):
+    orig_x = torch.Tensor([[1, 2], [3, 4]])
+    x = orig_x
+    xla_x = torch_xla._XLAC.XLATensor(orig_x)
+    # Every step uses the previous node twice, so without lowering shared nodes
+    # only once, the emitted graph would grow exponentially.
+    for i in range(0, 40):
+      x = x + 0.5 * x
+      xla_x = xla_x.add(0.5, xla_x)
+    self.assertEqualRel(x, xla_x.to_tensor(), rel_err=1e-3, abs_err=5)
+
+
+class TestDeviceCast(XlaTestCase):
+
+  def test(self):
+    orig_x = torch.randint(0, 256, (2, 3, 4, 5), dtype=torch.uint8)
+    device = torch_xla._XLAC.XLATensor(torch.zeros(1)).device()
+    xla_x, xla_y = torch_xla._XLAC._xla_create_tensors(
+        [orig_x, orig_x], [device, device],
+        casts=[None, (torch.float32, 1.0 / 255, -0.5)])
+    self.assertEqual(orig_x, xla_x.to_tensor())
+    self.assertEqualRel(
+        orig_x.float() / 255 - 0.5,
+        xla_y.to_tensor(),
+        rel_err=1e-2,
+        abs_err=1e-2)
+
+
+@unittest.skipIf(not (_support_replicated('TPU', 2) or
+                      _support_replicated('CPU', 2)),
+                 'Requires at least two devices of the same type')
+class TestTransferBetweenDevices(XlaTestCase):
+
+  def test(self):
+    x = torch.rand(2, 3, 4, 5)
+    xla_x = torch_xla._XLAC.XLATensor(x)
+    xla_x.add_(1.0, xla_x)
+    device = xla_x.device()
+    other_device = '{}:{}'.format(
+        device.split(':')[0], 1 if device.endswith(':0') else 0)
+    xla_y, xla_z = torch_xla._XLAC._xla_transfer_tensors(
+        [xla_x, xla_x], [other_device, device])
+    self.assertEqual(xla_y.device(), other_device)
+    self.assertEqual(xla_z.device(), device)
+    # The copies keep the device layout of the source data, so reading them
+    # back must give the same values.
+    self.assertEqual(list(x.size()), xla_y.size())
+    self.assertEqual(x + x, xla_y.to_tensor())
+    self.assertEqual(x + x, xla_z.to_tensor())
+    # The copies are independent from the source data.
+    xla_y.add_(1.0, xla_y)
+    self.assertEqual(x + x, xla_x.to_tensor())
+    self.assertEqual(4 * x, xla_y.to_tensor())
+
+
+class TestAsyncFetch(XlaTestCase):
+
+  def test(self):
+    x = torch.rand(2, 3)
+    y = torch.rand(2, 3)
+    xla_x = torch_xla._XLAC.XLATensor(x)
+    xla_y = torch_xla._XLAC.XLATensor(y)
+    xla_z = xla_x + xla_y
+    fetch = torch_xla._XLAC._xla_to_tensors_async([xla_x, xla_z])
+    # The tensors can be updated while the fetch is in flight.
+    xla_z.add_(xla_y)
+    fx, fz = fetch.wait()
+    self.assertTrue(fetch.is_ready())
+    self.assertEqual(x, fx)
+    self.assertEqual(x + y, fz)
+    self.assertEqual(x + y + y, xla_z.to_tensor())
+
+
+class TestAsyncApply(XlaTestCase):
+
+  def test(self):
+    if os.environ.get('XLA_ASYNC_APPLY', '0') == '0':
+      self.assertEqual(_run_with_env('TestAsyncApply', XLA_ASYNC_APPLY='1'), 0)
+      return
+    x = torch.rand(4, 3)
+    y = torch.rand(4, 3)
+    xla_x = torch_xla._XLAC.XLATensor(x)
+    xla_y = torch_xla._XLAC.XLATensor(y)
+    async_applies = torch_xla._XLAC._xla_counter_value('AsyncApplyGraph') or 0
+    for _ in range(0, 5):
+      # Every step is queued on the placeholder data of the previous one, which
+      # might still be in flight.
+      x.add_(0.5, y)
+      z = x * y
+      xla_x.add_(0.5, xla_y)
+      xla_z = xla_x.mul(xla_y)
+      torch_xla._XLAC._xla_sync_multi([xla_x, xla_z])
+    self.assertEqual(
+        torch_xla._XLAC._xla_counter_value('AsyncApplyGraph'),
+        async_applies + 5)
+    xla_x_value, xla_z_value = torch_xla._XLAC._xla_to_tensors([xla_x, xla_z])
+    self.assertEqualRel(x, xla_x_value, rel_err=1e-5, abs_err=1e-5)
+    self.assertEqualRel(z, xla_z_value, rel_err=1e-5, abs_err=1e-5)
+    self.assertEqual(y, xla_y.to_tensor())
+
+
+def _varint(value):
+  data = bytearray()
+  while value >= 0x80:
+    data.append((value & 0x7f) | 0x80)
+    value >>= 7
+  data.append(value)
+  return bytes(data)
+
+
+class TestCompilationManifest(XlaTestCase):
+
+  def _run(self, path, warmups):
+    return _run_with_env(
+        'TestCompilationManifest',
+        XLA_COMPILATION_MANIFEST=path,
+        XLA_TEST_MANIFEST_WARMUPS=str(warmups))
+
+  def test(self):
+    if 'XLA_COMPILATION_MANIFEST' not in os.environ:
+      tmpdir = tempfile.mkdtemp()
+      try:
+        path = os.path.join(tmpdir, 'manifest')
+        # The manifest gets written by the first process, at the latest when
+        # it exits, and warms up the compilations of the second one.
+        self.assertEqual(self._run(path, 0), 0)
+        self.assertTrue(os.path.isfile(path))
+        self.assertEqual(self._run(path, 1), 0)
+        header = _varint(5) + b'XLACM' + _varint(1)
+        corrupted_manifests = [
+            # More entries than the file could hold.
+            header + _varint(1 << 60) + b'\0' * 32,
+            # More devices than the file could hold.
+            header + _varint(1) + b'\0' * 16 + _varint(1) + _varint(0) +
+            _varint(1 << 60) + b'\0' * 8,
+        ]
+        for data in corrupted_manifests:
+          with open(path, 'wb') as fd:
+            fd.write(data)
+          # The corrupted manifest is ignored, and then overwritten.
+          self.assertEqual(self._run(path, 0), 0)
+          self.assertGreater(os.path.getsize(path), len(data))
+      finally:
+        shutil.rmtree(tmpdir)
+      return
+    self.assertEqual(
+        _metric_samples('CompilationWarmUpTime'),
+        int(os.environ['XLA_TEST_MANIFEST_WARMUPS']))
+    x = torch.rand(4, 3)
+    y = torch.rand(4, 3)
+    xla_x = torch_xla._XLAC.XLATensor(x)
+    xla_y = torch_xla._XLAC.XLATensor(y)
+    self.assertEqualRel(
+        x * y + y, xla_x.mul(xla_y).add(xla_y).to_tensor(), rel_err=1e-5)
+
+
+class TestConcurrentCompile(XlaTestCase):
+
+  def _run_concurrently(self, fn, num_threads):
+    start = threading.Event()
+    results = [None] * num_threads
+    errors = [None] * num_threads
+
+    def runner(index):
+      start.wait()
+      try:
+        results[index] = fn(index)
+      except Exception as e:
+        errors[index] = e
+
+    threads = [
+        threading.Thread(target=runner, args=(i,)) for i in range(num_threads)
+    ]
+    for thread in threads:
+      thread.daemon = True
+      thread.start()
+    start.set()
+    for thread in threads:
+      thread.join(120)
+      self.assertFalse(thread.is_alive(), 'Compilation did not complete')
+    return results, errors
+
+  def test_deduplicated(self):
+    num_threads = 8
+    deduplicated = torch_xla._XLAC._xla_counter_value(
+        'CompilationsDeduplicated') or 0
+    # The threads might not overlap while compiling, so a few graphs which
+    # have not been compiled yet are tried.
+    for size in range(17, 22):
+      xs = [torch.rand(size, size) for _ in range(0, num_threads)]
+      ys = []
+      xla_ys = []
+      for x in xs:
+        y = x
+        xla_x = torch_xla._XLAC.XLATensor(x)
+        xla_y = xla_x
+        for _ in range(0, 100):
+          y = y * 0.5 + x
+          xla_y = xla_y.mul(0.5).add(1.0, xla_x)
+        ys.append(y)
+        xla_ys.append(xla_y)
+      handles = torch_xla._XLAC._xla_counter_value('CreateCompileHandles') or 0
+      results, errors = self._run_concurrently(
+          lambda i: torch_xla._XLAC._xla_to_tensors([xla_ys[i]])[0],
+          num_threads)
+      self.assertEqual(errors, [None] * num_threads)
+      for y, result in zip(ys, results):
+        self.assertEqualRel(y, result, rel_err=1e-4, abs_err=1e-4)
+      # All the threads compiled the same computation, which has been
+      # compiled only once.
+      self.assertEqual(
+          torch_xla._XLAC._xla_counter_value('CreateCompileHandles'),
+          handles + 1)
+      if torch_xla._XLAC._xla_counter_value(
+          'CompilationsDeduplicated') > deduplicated:
+        break
+    self.assertGreater(
+        torch_xla._XLAC._xla_counter_value('CompilationsDeduplicated'),
+        deduplicated)
+
+  def test_failure(self):
+    # The copies to a device which does not exist, fail while compiling the
+    # computation creating the destination allocation, after it has been
+    # registered as in flight. The threads waiting for it must get the error.
+    num_threads = 8
+    device = torch_xla._XLAC.XLATensor(torch.zeros(1)).device()
+    missing_device = '{}:999'.format(device.split(':')[0])
+    xla_xs = [
+        torch_xla._XLAC.XLATensor(torch.rand(7, 9))
+        for _ in range(0, num_threads)
+    ]
+    _, errors = self._run_concurrently(
+        lambda i: torch_xla._XLAC._xla_transfer_tensors([xla_xs[i]],
+                                                         [missing_device]),
+        num_threads)
+    for error in errors:
+      self.assertIsNotNone(error)
+
+
+class TestApplyContextLiveTensors(XlaTestCase):
+
+  def test(self):
+    # The parameter updates read the scales device data, which is owned by
+    # tensors that are neither module parameters, gradients or inputs. The
+    # apply context must still map them, to reuse the cached apply operation.
+    model = nn.Linear(4, 2)
+    x = torch.rand(3, 4)
+    traced_model = torch.jit.trace(model, (x,))
+    xla_model = torch_xla._XLAC.XlaModule(traced_model)
+    xla_x = torch_xla._XLAC.XLATensor(x)
+    xla_grad_output = torch_xla._XLAC.XLATensor(torch.ones(3, 2))
+    xla_params = xla_model.parameters()[0]
+    xla_scales = [
+        torch_xla._XLAC.XLATensor(torch.full(p.size(), 0.01))
+        for p in xla_params
+    ]
+    cached_applies = torch_xla._XLAC._xla_counter_value('CachedApplyGraph') or 0
+    for _ in range(0, 4):
+      xla_model((xla_x,))
+      xla_model.backward((xla_grad_output,))
+      for p, scale in zip(xla_params, xla_scales):
+        p.addcmul_(-1.0, scale, p.grad)
+    xla_model((xla_x,))
+    self.assertGreater(
+        torch_xla._XLAC._xla_counter_value('CachedApplyGraph'), cached_applies)
+
+
+class TestApplyDonation(XlaTestCase):
+
+  def test(self):
+    # The SGD-like update reads the gradient, which is not overwritten by the
+    # apply. The gradient gets passed through the computation, so that its
+    # execution can still take over all the input device data.
+    p = torch.rand(4, 3)
+    g = torch.rand(4, 3)
+    xla_p = torch_xla._XLAC.XLATensor(p)
+    xla_g = torch_xla._XLAC.XLATensor(g)
+    donated_applies = torch_xla._XLAC._xla_counter_value(
+        'DonatedApplyGraph') or 0
+    donated_handles = torch_xla._XLAC._xla_counter_value(
+        'DonateDataHandles') or 0
+    for _ in range(0, 3):
+      p.add_(-0.1, g)
+      xla_p.add_(-0.1, xla_g)
+      torch_xla._XLAC._xla_sync_multi([xla_p])
+    self.assertEqual(
+        torch_xla._XLAC._xla_counter_value('DonatedApplyGraph'),
+        donated_applies + 3)
+    self.assertEqual(
+        torch_xla._XLAC._xla_counter_value('DonateDataHandles'),
+        donated_handles + 6)
+    self.assertEqualRel(p, xla_p.to_tensor(), rel_err=1e-5, abs_err=1e-5)
+    self.assertEqual(g, xla_g.to_tensor())
+
+
+class TestScalarsAsParameters(XlaTestCase):
+
+  def test(self):
+    if os.environ.get('XLA_SCALARS_AS_PARAMETERS', '0') == '0':
+      self.assertEqual(
+          _run_with_env(
+              'TestScalarsAsParameters', XLA_SCALARS_AS_PARAMETERS='1'), 0)
+      return
+    # The Linear gradients with all ones output gradients do not depend on the
+    # parameters, so the updates add up to the sum of the learning rates.
+    model = nn.Linear(4, 2)
+    x = torch.rand(3, 4)
+    grad_output = torch.ones(3, 2)
+    params = [p.data.clone() for p in model.parameters()]
+    model(x).backward(grad_output)
+    grads = [p.grad.clone() for p in model.parameters()]
+    traced_model = torch.jit.trace(model, (x,))
+    xla_model = torch_xla._XLAC.XlaModule(traced_model)
+    xla_x = torch_xla._XLAC.XLATensor(x)
+    xla_grad_output = torch_xla._XLAC.XLATensor(grad_output)
+    xla_params = xla_model.parameters()[0]
+    lrs = [0.01 * (i + 1) for i in range(0, 6)]
+    for step, lr in enumerate(lrs):
+      if step == 2:
+        # The first updates have been applied, and the apply context entry
+        # created. Changing the learning rate must not invalidate it.
+        cached_applies = torch_xla._XLAC._xla_counter_value(
+            'CachedApplyGraph') or 0
+        uncached_applies = torch_xla._XLAC._xla_counter_value(
+            'UncachedApplyGraph') or 0
+        compiles = _metric_samples('CompileTime')
+      xla_model((xla_x,))
+      xla_model.backward((xla_grad_output,))
+      for p in xla_params:
+        p.add_(-lr, p.grad)
+    xla_model((xla_x,))
+    self.assertGreater(
+        torch_xla._XLAC._xla_counter_value('CachedApplyGraph'), cached_applies)
+    self.assertEqual(
+        torch_xla._XLAC._xla_counter_value('UncachedApplyGraph') or 0,
+        uncached_applies)
+    self.assertEqual(_metric_samples('CompileTime'), compiles)
+    for p, g, xla_p in zip(params, grads, xla_params):
+      self.assertEqualRel(
+          p - sum(lrs) * g, xla_p.to_tensor(), rel_err=1e-4, abs_err=1e-4)
+
+
+class TestScalarOpTypes(XlaTestCase):
+
+  def test(self):
+    orig_x = torch.Tensor([[1, 2], [3, 50]])
+    for dtype in [
+        torch.uint8, torch.int8, torch.int16, torch.int32, torch.float16,
+        torch.float64
+    ]:
+      x = orig_x.to(dtype)
+      xla_x = torch_xla._XLAC.XLATensor(x)
+      xla_y = xla_x.mul(2)
+      y = xla_y.to_tensor()
+      self.assertEqual(y.dtype, dtype)
+      self.assertEqual((orig_x.double() * 2).to(dtype), y)
+
+
 class TestGradients(XlaTestCase):
 
   def checkGrad(self,
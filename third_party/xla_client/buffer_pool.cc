@@ -0,0 +1,74 @@
+#include "tensorflow/compiler/xla/xla_client/buffer_pool.h"
+
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/core/lib/core/bits.h"
+
+namespace xla {
+namespace util {
+namespace {
+
+// Below this size the allocator serves requests out of its own free lists
+// anyway, so pooling buffers does not pay off.
+constexpr int kMinSizeClass = 16;
+
+metrics::Counter* ResidentBytesCounter() {
+  static metrics::Counter* counter =
+      new metrics::Counter("StagingBufferPoolResidentBytes");
+  return counter;
+}
+
+}  // namespace
+
+StagingBufferPool::StagingBufferPool(size_t max_resident_bytes)
+    : max_resident_bytes_(max_resident_bytes), size_classes_(64) {}
+
+string StagingBufferPool::Acquire(size_t size) {
+  int size_class = tensorflow::Log2Ceiling64(size);
+  if (size_class >= kMinSizeClass) {
+    std::lock_guard<std::mutex> slock(lock_);
+    std::vector<string>* buffers = &size_classes_[size_class];
+    if (!buffers->empty()) {
+      string buffer = std::move(buffers->back());
+      buffers->pop_back();
+      resident_bytes_ -= buffer.size();
+      ResidentBytesCounter()->AddValue(-static_cast<int64>(buffer.size()));
+      XLA_COUNTER("StagingBufferPoolHits", 1);
+      // Pooled buffers are kept sized to their capacity, so this only moves
+      // the string end, without touching the buffer memory.
+      buffer.resize(size);
+      return buffer;
+    }
+    XLA_COUNTER("StagingBufferPoolMisses", 1);
+  }
+  string buffer;
+  if (size_class >= kMinSizeClass) {
+    buffer.reserve(static_cast<size_t>(1) << size_class);
+  }
+  buffer.resize(size);
+  return buffer;
+}
+
+void StagingBufferPool::Release(string buffer) {
+  int size_class = tensorflow::Log2Floor64(buffer.capacity());
+  if (size_class < kMinSizeClass) {
+    return;
+  }
+  buffer.resize(buffer.capacity());
+  std::lock_guard<std::mutex> slock(lock_);
+  if (resident_bytes_ + buffer.size() > max_resident_bytes_) {
+    return;
+  }
+  resident_bytes_ += buffer.size();
+  ResidentBytesCounter()->AddValue(buffer.size());
+  size_classes_[size_class].push_back(std::move(buffer));
+}
+
+StagingBufferPool* StagingBufferPool::Get() {
+  static StagingBufferPool* pool = new StagingBufferPool(
+      sys_util::GetEnvInt("XLA_STAGING_BUFFER_POOL_SIZE", 1LL << 30));
+  return pool;
+}
+
+}  // namespace util
+}  // namespace xla
@@ -0,0 +1,44 @@
+#ifndef TENSORFLOW_COMPILER_XLA_XLA_CLIENT_BUFFER_POOL_H_
+#define TENSORFLOW_COMPILER_XLA_XLA_CLIENT_BUFFER_POOL_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace util {
+
+// Thread safe pool of host buffers used to stage the tensor data moving to and
+// from the devices, so that the large allocations (and the page faults which
+// come with them) are not paid again at every step. Buffers are string objects
+// (so that they can be moved within the tensorflow::Tensor objects fed to the
+// sessions), and are grouped in power of two size classes.
+class StagingBufferPool {
+ public:
+  explicit StagingBufferPool(size_t max_resident_bytes);
+
+  // Returns a buffer of the given size, whose content is not specified.
+  string Acquire(size_t size);
+
+  // Returns a buffer to the pool. The buffer is dropped if it is too small to
+  // be worth recycling, or if keeping it would make the bytes resident within
+  // the pool exceed the limit set at construction.
+  void Release(string buffer);
+
+  // Retrieves the process wide pool, whose size is controlled by the
+  // XLA_STAGING_BUFFER_POOL_SIZE environment variable (in bytes).
+  static StagingBufferPool* Get();
+
+ private:
+  std::mutex lock_;
+  size_t max_resident_bytes_;
+  size_t resident_bytes_ = 0;
+  std::vector<std::vector<string>> size_classes_;
+};
+
+}  // namespace util
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_XLA_CLIENT_BUFFER_POOL_H_
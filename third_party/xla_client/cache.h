@@ -14,7 +14,15 @@ namespace util {
 template <typename K, typename T, typename H = std::hash<K>,
           typename E = std::equal_to<K>>
 class Cache {
-  using Element = std::pair<K, T>;
+  struct Element {
+    Element(K key, T object, size_t weight)
+        : key(std::move(key)), object(std::move(object)), weight(weight) {}
+
+    K key;
+    T object;
+    size_t weight;
+  };
+
   using ElementList = std::list<Element>;
 
   struct Hasher {
@@ -36,22 +44,44 @@ class Cache {
                          Equaler>;
 
  public:
+  using WeightFn = std::function<size_t(const T&)>;
+
   explicit Cache(size_t max_size) : max_size_(max_size) {}
 
+  // Creates a cache which is limited both in number of objects (max_size), and
+  // in the sum of their weights (max_weight), as returned by weight_fn. A zero
+  // max_weight means no weight limit.
+  Cache(size_t max_size, size_t max_weight, WeightFn weight_fn)
+      : max_size_(max_size),
+        max_weight_(max_weight),
+        weight_fn_(std::move(weight_fn)) {}
+
   // Adds an object to the cache, unless it already exists. If the cache grows
-  // beyond the limit set during construction, the oldest used object will be
-  // removed from the cache.
-  void Add(K key, T object) {
+  // beyond the limits set during construction, the oldest used objects will be
+  // removed from the cache. The weight limit never removes the last object
+  // left, so objects heavier than the limit still get cached. Returns the
+  // number of removed objects.
+  size_t Add(K key, T object) {
+    size_t weight = weight_fn_ ? weight_fn_(object) : 0;
     std::lock_guard<std::mutex> slock(lock_);
-    element_list_.emplace_front(Element(std::move(key), std::move(object)));
+    element_list_.emplace_front(std::move(key), std::move(object), weight);
     auto it = element_list_.begin();
-    if (!element_map_.emplace(&it->first, it).second) {
+    if (!element_map_.emplace(&it->key, it).second) {
       element_list_.erase(it);
-    } else if (element_list_.size() > max_size_) {
+      return 0;
+    }
+    weight_ += weight;
+    size_t evicted = 0;
+    while (element_list_.size() > max_size_ ||
+           (max_weight_ > 0 && weight_ > max_weight_ &&
+            element_list_.size() > 1)) {
       Element* last = &element_list_.back();
-      element_map_.erase(&last->first);
+      weight_ -= last->weight;
+      element_map_.erase(&last->key);
       element_list_.pop_back();
+      ++evicted;
     }
+    return evicted;
   }
 
   // Retrieves the existing object if it exists. If it does, it's position in
@@ -68,7 +98,7 @@ class Cache {
       // LRU re-positioning.
       element_list_.splice(element_list_.begin(), element_list_, it->second);
     }
-    return &it->second->second;
+    return &it->second->object;
   }
 
   bool Erase(const K& key) {
@@ -77,7 +107,8 @@ class Cache {
     if (it == element_map_.end()) {
       return false;
     }
-    auto lit = it->second->second;
+    auto lit = it->second;
+    weight_ -= lit->weight;
     element_map_.erase(it);
     element_list_.erase(lit);
     return true;
@@ -87,11 +118,21 @@ class Cache {
     std::lock_guard<std::mutex> slock(lock_);
     element_map_.clear();
     element_list_.clear();
+    weight_ = 0;
+  }
+
+  // Returns the sum of the weights of the objects within the cache.
+  size_t Weight() {
+    std::lock_guard<std::mutex> slock(lock_);
+    return weight_;
   }
 
  private:
   std::mutex lock_;
   size_t max_size_ = 0;
+  size_t max_weight_ = 0;
+  WeightFn weight_fn_;
+  size_t weight_ = 0;
   ElementList element_list_;
   ElementMap element_map_;
 };
@@ -0,0 +1,291 @@
+#include "tensorflow/compiler/xla/xla_client/compilation_manifest.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace xla {
+namespace {
+
+constexpr char kMagic[] = "XLACM";
+// Bumped every time the file layout changes. Files written with a different
+// version are ignored, and overwritten at the next flush.
+constexpr uint64 kVersion = 1;
+// Count only updates happen at every step, so they are not written out more
+// often than this.
+constexpr auto kCountsFlushInterval = std::chrono::seconds(30);
+// Smallest encoded sizes, used to validate the counts read from the file
+// before allocating for them. An entry holds the two fixed 64 bit key halves,
+// and at least one byte for each of the count, computation size and number of
+// devices varints. A device holds at least one byte for its size varint.
+constexpr uint64 kMinEntrySize = 2 * sizeof(uint64) + 3;
+constexpr uint64 kMinDeviceSize = 1;
+
+void PutString(string* dst, const string& value) {
+  tensorflow::core::PutVarint64(dst, value.size());
+  dst->append(value);
+}
+
+bool GetString(tensorflow::StringPiece* input, string* value) {
+  uint64 size;
+  if (!tensorflow::core::GetVarint64(input, &size) || input->size() < size) {
+    return false;
+  }
+  value->assign(input->data(), size);
+  input->remove_prefix(size);
+  return true;
+}
+
+bool GetFixed64(tensorflow::StringPiece* input, uint64* value) {
+  if (input->size() < sizeof(uint64)) {
+    return false;
+  }
+  *value = tensorflow::core::DecodeFixed64(input->data());
+  input->remove_prefix(sizeof(uint64));
+  return true;
+}
+
+// The manifests which get flushed at process exit. The computation clients
+// owning them are never destroyed.
+struct LiveManifests {
+  std::mutex lock;
+  std::set<CompilationManifest*> manifests;
+};
+
+LiveManifests* GetLiveManifests();
+
+void FlushLiveManifests() {
+  LiveManifests* live_manifests = GetLiveManifests();
+  std::lock_guard<std::mutex> lock(live_manifests->lock);
+  for (auto manifest : live_manifests->manifests) {
+    manifest->Flush();
+  }
+}
+
+LiveManifests* GetLiveManifests() {
+  static LiveManifests* live_manifests = []() {
+    std::atexit(FlushLiveManifests);
+    return new LiveManifests();
+  }();
+  return live_manifests;
+}
+
+}  // namespace
+
+CompilationManifest::CompilationManifest(string path, size_t max_entries)
+    : path_(std::move(path)),
+      max_entries_(max_entries),
+      last_flush_time_(Clock::now()) {
+  Load();
+  flush_task_.reset(new xla_util::TriggeredTask(
+      [this]() { Write(/*force=*/false); }, /*num_threads=*/1));
+  LiveManifests* live_manifests = GetLiveManifests();
+  std::lock_guard<std::mutex> lock(live_manifests->lock);
+  live_manifests->manifests.insert(this);
+}
+
+CompilationManifest::~CompilationManifest() {
+  {
+    LiveManifests* live_manifests = GetLiveManifests();
+    std::lock_guard<std::mutex> lock(live_manifests->lock);
+    live_manifests->manifests.erase(this);
+  }
+  flush_task_->Stop();
+  Flush();
+}
+
+std::vector<CompilationManifest::Entry> CompilationManifest::GetHottest(
+    size_t count) const {
+  std::vector<Entry> entries;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    entries.reserve(entries_.size());
+    for (auto& key_entry : entries_) {
+      entries.push_back(key_entry.second);
+    }
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& e1, const Entry& e2) {
+              return e1.count > e2.count;
+            });
+  if (entries.size() > count) {
+    entries.resize(count);
+  }
+  return entries;
+}
+
+void CompilationManifest::Record(
+    const tensorflow::Fprint128& key, const string& serialized_computation,
+    tensorflow::gtl::ArraySlice<const string> devices) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    it->second.count += 1;
+    new_counts_ = true;
+    return;
+  }
+  if (max_entries_ == 0) {
+    return;
+  }
+  if (entries_.size() >= max_entries_) {
+    EvictColdest();
+  }
+  Entry entry;
+  entry.key = key;
+  entry.serialized_computation = serialized_computation;
+  entry.devices.assign(devices.begin(), devices.end());
+  entry.count = 1;
+  entries_.emplace(key, std::move(entry));
+  new_entries_ = true;
+}
+
+void CompilationManifest::MaybeFlush() {
+  bool needs_flush;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    needs_flush = NeedsFlush(Clock::now(), /*force=*/false);
+  }
+  if (needs_flush) {
+    flush_task_->Activate();
+  }
+}
+
+void CompilationManifest::Flush() { Write(/*force=*/true); }
+
+bool CompilationManifest::NeedsFlush(Clock::time_point now,
+                                     bool force) const {
+  return new_entries_ ||
+         (new_counts_ &&
+          (force || now - last_flush_time_ >= kCountsFlushInterval));
+}
+
+void CompilationManifest::Write(bool force) {
+  std::lock_guard<std::mutex> flush_lock(flush_lock_);
+  string data;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    Clock::time_point now = Clock::now();
+    if (!NeedsFlush(now, force)) {
+      return;
+    }
+    data = Serialize();
+    new_entries_ = false;
+    new_counts_ = false;
+    last_flush_time_ = now;
+  }
+  // Write to a temporary file first, so that a crash while writing never
+  // leaves a truncated manifest behind.
+  tensorflow::Env* env = tensorflow::Env::Default();
+  string tmp_path = absl::StrCat(path_, ".tmp");
+  tensorflow::Status status =
+      tensorflow::WriteStringToFile(env, tmp_path, data);
+  if (status.ok()) {
+    status = env->RenameFile(tmp_path, path_);
+  }
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Unable to write compilation manifest " << path_ << ": "
+                    << status;
+    return;
+  }
+  XLA_COUNTER("CompilationManifestFlushes", 1);
+}
+
+void CompilationManifest::Load() {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  if (!env->FileExists(path_).ok()) {
+    return;
+  }
+  string data;
+  tensorflow::Status status = tensorflow::ReadFileToString(env, path_, &data);
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Unable to read compilation manifest " << path_ << ": "
+                    << status;
+    return;
+  }
+  tensorflow::StringPiece input(data);
+  string magic;
+  uint64 version;
+  uint64 num_entries;
+  if (!GetString(&input, &magic) || magic != kMagic ||
+      !tensorflow::core::GetVarint64(&input, &version) ||
+      version != kVersion ||
+      !tensorflow::core::GetVarint64(&input, &num_entries)) {
+    TF_LOG(WARNING) << "Ignoring compilation manifest " << path_
+                    << " with unknown format";
+    return;
+  }
+  if (num_entries > input.size() / kMinEntrySize) {
+    TF_LOG(WARNING) << "Ignoring corrupted compilation manifest " << path_;
+    return;
+  }
+  std::unordered_map<tensorflow::Fprint128, Entry, tensorflow::Fprint128Hasher>
+      entries;
+  for (uint64 i = 0; i < num_entries; ++i) {
+    Entry entry;
+    uint64 count;
+    uint64 num_devices;
+    if (!GetFixed64(&input, &entry.key.low64) ||
+        !GetFixed64(&input, &entry.key.high64) ||
+        !tensorflow::core::GetVarint64(&input, &count) ||
+        !GetString(&input, &entry.serialized_computation) ||
+        !tensorflow::core::GetVarint64(&input, &num_devices) ||
+        num_devices > input.size() / kMinDeviceSize) {
+      TF_LOG(WARNING) << "Ignoring corrupted compilation manifest " << path_;
+      return;
+    }
+    entry.count = count;
+    entry.devices.resize(num_devices);
+    for (auto& device : entry.devices) {
+      if (!GetString(&input, &device)) {
+        TF_LOG(WARNING) << "Ignoring corrupted compilation manifest " << path_;
+        return;
+      }
+    }
+    entries.emplace(entry.key, std::move(entry));
+  }
+  TF_VLOG(1) << "Loaded " << entries.size()
+             << " entries from compilation manifest " << path_;
+
+  std::lock_guard<std::mutex> lock(lock_);
+  entries_ = std::move(entries);
+  // The file might have been written with a larger limit.
+  while (entries_.size() > max_entries_) {
+    EvictColdest();
+  }
+}
+
+void CompilationManifest::EvictColdest() {
+  auto coldest = std::min_element(
+      entries_.begin(), entries_.end(), [](const auto& e1, const auto& e2) {
+        return e1.second.count < e2.second.count;
+      });
+  entries_.erase(coldest);
+}
+
+string CompilationManifest::Serialize() const {
+  string data;
+  PutString(&data, kMagic);
+  tensorflow::core::PutVarint64(&data, kVersion);
+  tensorflow::core::PutVarint64(&data, entries_.size());
+  for (auto& key_entry : entries_) {
+    const Entry& entry = key_entry.second;
+    tensorflow::core::PutFixed64(&data, entry.key.low64);
+    tensorflow::core::PutFixed64(&data, entry.key.high64);
+    tensorflow::core::PutVarint64(&data, entry.count);
+    PutString(&data, entry.serialized_computation);
+    tensorflow::core::PutVarint64(&data, entry.devices.size());
+    for (auto& device : entry.devices) {
+      PutString(&data, device);
+    }
+  }
+  return data;
+}
+
+}  // namespace xla
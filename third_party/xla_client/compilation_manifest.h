@@ -0,0 +1,88 @@
+#ifndef TENSORFLOW_COMPILER_XLA_XLA_CLIENT_COMPILATION_MANIFEST_H_
+#define TENSORFLOW_COMPILER_XLA_XLA_CLIENT_COMPILATION_MANIFEST_H_
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_client/triggered_task.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/platform/fingerprint.h"
+
+namespace xla {
+
+// Persistent record of the computations compiled by a client, together with
+// the number of times they have been requested, which is used to compile the
+// hottest ones upfront when a new process starts. The manifest is stored
+// within a local file, which is rewritten atomically at every flush. Flushes
+// happen on a background thread, and once more at process exit.
+class CompilationManifest {
+ public:
+  struct Entry {
+    tensorflow::Fprint128 key;
+    // The serialized xrt::XLAComputation proto.
+    string serialized_computation;
+    std::vector<string> devices;
+    int64 count = 0;
+  };
+
+  // Creates a manifest stored at path, and loads its entries if the file
+  // exists. The manifest keeps at most max_entries, dropping the least
+  // requested ones to make room for the new ones.
+  CompilationManifest(string path, size_t max_entries);
+
+  ~CompilationManifest();
+
+  // Returns up to count entries, most requested first.
+  std::vector<Entry> GetHottest(size_t count) const;
+
+  // Records a request of the computation with the given key. The serialized
+  // computation is only copied if the key is not already in the manifest.
+  void Record(const tensorflow::Fprint128& key,
+              const string& serialized_computation,
+              tensorflow::gtl::ArraySlice<const string> devices);
+
+  // Schedules a background write of the manifest file, if new entries have
+  // been recorded since the last flush, or if only the counts changed but the
+  // last flush is older than thirty seconds. Does not wait for the write.
+  void MaybeFlush();
+
+  // Writes the manifest file if anything changed since the last flush, and
+  // waits for the write to complete.
+  void Flush();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  // Must be called while holding lock_.
+  bool NeedsFlush(Clock::time_point now, bool force) const;
+
+  void Write(bool force);
+
+  void Load();
+
+  void EvictColdest();
+
+  string Serialize() const;
+
+  string path_;
+  size_t max_entries_;
+  std::mutex flush_lock_;
+  // Access to the following members must be done while holding lock_.
+  mutable std::mutex lock_;
+  std::unordered_map<tensorflow::Fprint128, Entry, tensorflow::Fprint128Hasher>
+      entries_;
+  bool new_entries_ = false;
+  bool new_counts_ = false;
+  Clock::time_point last_flush_time_;
+  // Created last, as its thread uses the members above.
+  std::unique_ptr<xla_util::TriggeredTask> flush_task_;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_XLA_CLIENT_COMPILATION_MANIFEST_H_
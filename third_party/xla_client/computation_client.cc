@@ -173,6 +173,12 @@ metrics::Metric* ComputationClient::TransferFromServerMetric() {
   return metric;
 }
 
+metrics::Metric* ComputationClient::TransferBetweenDevicesMetric() {
+  static metrics::Metric* metric = new metrics::Metric(
+      "TransferBetweenDevicesTime", metrics::MetricFnTime);
+  return metric;
+}
+
 metrics::Metric* ComputationClient::CompileMetric() {
   static metrics::Metric* metric =
       new metrics::Metric("CompileTime", metrics::MetricFnTime);
@@ -197,6 +203,12 @@ metrics::Metric* ComputationClient::ExecuteParallelMetric() {
   return metric;
 }
 
+metrics::Metric* ComputationClient::ExecuteParallelAndFetchMetric() {
+  static metrics::Metric* metric = new metrics::Metric(
+      "ExecuteParallelAndFetchTime", metrics::MetricFnTime);
+  return metric;
+}
+
 metrics::Metric* ComputationClient::DeconstructTupleMetric() {
   static metrics::Metric* metric =
       new metrics::Metric("DeconstructTupleTime", metrics::MetricFnTime);
@@ -221,6 +233,11 @@ metrics::Counter* ComputationClient::DestroyDataHandlesCounter() {
   return counter;
 }
 
+metrics::Counter* ComputationClient::DonateDataHandlesCounter() {
+  static metrics::Counter* counter = new metrics::Counter("DonateDataHandles");
+  return counter;
+}
+
 metrics::Metric* ComputationClient::ReleaseDataHandlesTimeMetric() {
   static metrics::Metric* metric =
       new metrics::Metric("ReleaseDataHandlesTime", metrics::MetricFnTime);
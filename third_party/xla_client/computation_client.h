@@ -1,6 +1,7 @@
 #ifndef TENSORFLOW_COMPILER_XLA_RPC_COMPUTATION_CLIENT_H_
 #define TENSORFLOW_COMPILER_XLA_RPC_COMPUTATION_CLIENT_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -74,6 +75,35 @@ class ComputationClient {
     string device;
   };
 
+  // Describes a host tensor to be uploaded to a device, together with the
+  // populate_fn callback in charge of writing its values. The transfer calls
+  // populate_fn(source, buffer, size) to fill the size bytes (which always
+  // match ShapeUtil::ByteSizeOf(shape)) of buffer with the tensor values,
+  // stored in the order defined by the shape layout. The buffer can be the
+  // memory area going over the wire, so the callback should write it only once.
+  struct TensorSource {
+    using PopulateFn = std::function<void(const TensorSource&, void*, size_t)>;
+
+    TensorSource() = default;
+    TensorSource(Shape shape, string device, PopulateFn populate_fn)
+        : shape(std::move(shape)),
+          device(std::move(device)),
+          populate_fn(std::move(populate_fn)) {}
+
+    Shape shape;
+    string device;
+    PopulateFn populate_fn;
+  };
+
+  // Receives the values fetched by TransferTensorsFromServer(). The
+  // consumer_fn(index, shape, buffer, size) call gets the index of the handle,
+  // the shape (with layout) of its data, and the size bytes of buffer holding
+  // the values, stored in the order defined by the shape layout. The buffer is
+  // only valid for the duration of the call, and it might not be aligned to the
+  // natural alignment of the shape element type.
+  using TensorConsumerFn =
+      std::function<void(size_t, const Shape&, const void*, size_t)>;
+
   struct CompileInstance {
     CompileInstance() = default;
     CompileInstance(XlaComputation computation, std::vector<string> devices,
@@ -89,6 +119,10 @@ class ComputationClient {
 
   struct ExecuteOptions {
     bool explode_tuple = true;
+    // If true, the device memory behind the arguments is released by the
+    // execution, which can reuse it for the results. The argument Data objects
+    // must not be used as computation inputs afterwards.
+    bool release_input_handles = false;
   };
 
   struct ExecuteComputationOptions : public ExecuteOptions {};
@@ -106,11 +140,42 @@ class ComputationClient {
   virtual std::vector<std::shared_ptr<Data>> TransferToServer(
       tensorflow::gtl::ArraySlice<const LiteralDevice> literals) = 0;
 
+  // Transfers local tensors to the TPU servers and fetches the handles. Unlike
+  // TransferToServer(), the tensor values do not need to be staged within
+  // Literal objects, as they are written by the TensorSource::populate_fn
+  // callbacks straight into the transfer buffers.
+  virtual std::vector<std::shared_ptr<Data>> TransferTensorsToServer(
+      tensorflow::gtl::ArraySlice<const TensorSource> tensors) = 0;
+
   // Reads the tensor literal values stored at TPU server sites, behind the
   // supplied handles.
   virtual std::vector<Literal> TransferFromServer(
       tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles) = 0;
 
+  // Transfers local tensors to all the given devices, converting each of them
+  // only once. The TensorSource::device field is not used, and the returned
+  // result[i][j] is the handle of tensors[i] on devices[j].
+  virtual std::vector<std::vector<std::shared_ptr<Data>>>
+  BroadcastTensorsToServer(
+      tensorflow::gtl::ArraySlice<const TensorSource> tensors,
+      tensorflow::gtl::ArraySlice<const string> devices) = 0;
+
+  // Reads the tensor values stored at TPU server sites, behind the supplied
+  // handles. Unlike TransferFromServer(), no Literal objects are created, as
+  // the values are handed to consumer_fn directly out of the transfer buffers.
+  // The handles must refer to array (non tuple) data.
+  virtual void TransferTensorsFromServer(
+      tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles,
+      const TensorConsumerFn& consumer_fn) = 0;
+
+  // Copies the device data behind handles[i] to devices[i], returning the
+  // handles of the copies. The data moves between the devices within the
+  // servers, without going through the local host. The handles must refer to
+  // array (non tuple) data.
+  virtual std::vector<std::shared_ptr<Data>> TransferBetweenDevices(
+      tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles,
+      tensorflow::gtl::ArraySlice<const string> devices) = 0;
+
   // Compiles a set of computations.
   virtual std::vector<std::shared_ptr<Computation>> Compile(
       std::vector<CompileInstance> instances) = 0;
@@ -154,6 +219,20 @@ class ComputationClient {
       tensorflow::gtl::ArraySlice<const string> devices,
       const ExecuteParallelOptions& options) = 0;
 
+  // Like ExecuteParallel(), but also fetches, within the same round trip, the
+  // host literals of the results of computations[i] selected by
+  // fetch_indices[i]. The literals are stored within (*literals)[i], following
+  // the fetch_indices[i] order. If options.explode_tuple is false, the only
+  // valid fetch index is zero, which fetches the whole computation result.
+  virtual std::vector<std::vector<std::shared_ptr<Data>>>
+  ExecuteParallelAndFetch(
+      tensorflow::gtl::ArraySlice<const Computation* const> computations,
+      const std::vector<std::vector<Data*>>& arguments,
+      tensorflow::gtl::ArraySlice<const string> devices,
+      const std::vector<std::vector<int64>>& fetch_indices,
+      std::vector<std::vector<Literal>>* literals,
+      const ExecuteParallelOptions& options) = 0;
+
   virtual std::vector<std::vector<std::shared_ptr<Data>>> DeconstructTuple(
       tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> tuples) = 0;
 
@@ -173,14 +252,17 @@ class ComputationClient {
   // Metrics common to all client intrfaces.
   static metrics::Metric* TransferToServerMetric();
   static metrics::Metric* TransferFromServerMetric();
+  static metrics::Metric* TransferBetweenDevicesMetric();
   static metrics::Metric* CompileMetric();
   static metrics::Metric* ExecuteMetric();
   static metrics::Metric* ExecuteReplicatedMetric();
   static metrics::Metric* ExecuteParallelMetric();
+  static metrics::Metric* ExecuteParallelAndFetchMetric();
   static metrics::Metric* DeconstructTupleMetric();
   static metrics::Counter* CreateDataHandlesCounter();
   static metrics::Counter* ReleaseDataHandlesCounter();
   static metrics::Counter* DestroyDataHandlesCounter();
+  static metrics::Counter* DonateDataHandlesCounter();
   static metrics::Metric* ReleaseDataHandlesTimeMetric();
   static metrics::Counter* CreateCompileHandlesCounter();
   static metrics::Counter* ReleaseCompileHandlesCounter();
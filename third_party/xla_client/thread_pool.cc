@@ -1,5 +1,12 @@
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/cpu_info.h"
@@ -31,6 +38,20 @@ tensorflow::thread::ThreadPool* GetIoThreadPool() {
   return pool;
 }
 
+struct ParallelForState {
+  explicit ParallelForState(int64 num_ranges) : num_ranges(num_ranges) {}
+
+  const int64 num_ranges;
+  std::atomic<int64> next_range{0};
+  // Set once a range failed, so that the ranges not started yet get skipped.
+  std::atomic<bool> failed{false};
+  std::mutex mutex;
+  std::condition_variable cv;
+  int64 completed_ranges = 0;
+  // The first exception thrown by a range.
+  std::exception_ptr exception;
+};
+
 }  // namespace
 
 void ScheduleClosure(std::function<void()> closure) {
@@ -41,5 +62,66 @@ void ScheduleIoClosure(std::function<void()> closure) {
   GetIoThreadPool()->Schedule(std::move(closure));
 }
 
+void ParallelFor(int64 count, int64 min_range_size,
+                 const std::function<void(int64, int64)>& fn) {
+  tensorflow::thread::ThreadPool* pool = GetThreadPool();
+  int64 range_size = std::max<int64>(min_range_size, 1);
+  int64 num_ranges =
+      std::min<int64>((count + range_size - 1) / range_size,
+                      4 * static_cast<int64>(pool->NumThreads()));
+  if (num_ranges <= 1) {
+    if (count > 0) {
+      fn(0, count);
+    }
+    return;
+  }
+  range_size = (count + num_ranges - 1) / num_ranges;
+  num_ranges = (count + range_size - 1) / range_size;
+
+  // The state is shared with the pool closures, which can outlive this call.
+  // The fn reference is only used for the ranges taken before all of them have
+  // completed, and hence while this call is still waiting. The runner never
+  // throws, as every range taken must be accounted as completed, even if fn
+  // fails, or this call would either wait forever or return (and let fn go
+  // away) while others are still using it.
+  auto state = std::make_shared<ParallelForState>(num_ranges);
+  auto runner = [state, count, range_size, &fn]() {
+    for (;;) {
+      int64 range = state->next_range.fetch_add(1);
+      if (range >= state->num_ranges) {
+        break;
+      }
+      std::exception_ptr exception;
+      if (!state->failed) {
+        int64 start = range * range_size;
+        try {
+          fn(start, std::min(start + range_size, count));
+        } catch (...) {
+          exception = std::current_exception();
+          state->failed = true;
+        }
+      }
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (exception != nullptr && state->exception == nullptr) {
+        state->exception = std::move(exception);
+      }
+      if (++state->completed_ranges == state->num_ranges) {
+        state->cv.notify_all();
+      }
+    }
+  };
+  int64 num_closures = std::min<int64>(num_ranges - 1, pool->NumThreads());
+  for (int64 i = 0; i < num_closures; ++i) {
+    pool->Schedule(runner);
+  }
+  runner();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock,
+                 [&] { return state->completed_ranges == state->num_ranges; });
+  if (state->exception != nullptr) {
+    std::rethrow_exception(state->exception);
+  }
+}
+
 }  // namespace xla_env
 }  // namespace xla
@@ -3,6 +3,8 @@
 
 #include <functional>
 
+#include "tensorflow/compiler/xla/types.h"
+
 namespace xla {
 namespace xla_env {
 
@@ -12,6 +14,17 @@ void ScheduleClosure(std::function<void()> closure);
 // Schedules a closure which might wait for IO or other events/conditions.
 void ScheduleIoClosure(std::function<void()> closure);
 
+// Runs fn(start, end) over non overlapping ranges covering [0, count), spread
+// over the XLA thread pool. Ranges are at least min_range_size long (but the
+// last one). The calling thread takes part to the work, and returns once all
+// the ranges have been processed. Pool closures which start running after all
+// the ranges have been taken exit immediately, so it is safe to call this API
+// from closures running within the XLA thread pool. If fn throws, the ranges
+// not started yet are skipped, and the first exception is rethrown once the
+// started ones have completed.
+void ParallelFor(int64 count, int64 min_range_size,
+                 const std::function<void(int64, int64)>& fn);
+
 }  // namespace xla_env
 }  // namespace xla
 
@@ -1,14 +1,32 @@
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 
 #include <stdexcept>
+#include <unordered_map>
 
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/platform/stacktrace.h"
 
 namespace xla {
 namespace xrt_util {
+namespace {
+
+// XlaBuilder names computations and instructions as BASE.ID, with ID drawn
+// from a process wide counter. Replaces the ID suffix with the new one.
+string RenumberName(const string& name, int64 id, int64 new_id) {
+  string suffix = absl::StrCat(".", id);
+  if (!absl::EndsWith(name, suffix)) {
+    return name;
+  }
+  return absl::StrCat(name.substr(0, name.size() - suffix.size()), ".",
+                      new_id);
+}
+
+}  // namespace
 
 StatusOr<std::unique_ptr<HloModule>> CreateModuleFromProto(
     const HloModuleProto& proto, const DebugOptions& debug_options) {
@@ -38,5 +56,53 @@ void CheckComputationStatus(
   }
 }
 
+void CanonicalizeHloModule(HloModuleProto* module) {
+  std::unordered_map<int64, int64> computation_ids;
+  std::unordered_map<int64, int64> instruction_ids;
+  for (auto& computation : module->computations()) {
+    computation_ids.emplace(computation.id(), computation_ids.size() + 1);
+    for (auto& instruction : computation.instructions()) {
+      instruction_ids.emplace(instruction.id(), instruction_ids.size() + 1);
+    }
+  }
+  auto map_id = [](const std::unordered_map<int64, int64>& ids, int64 id) {
+    auto it = ids.find(id);
+    XLA_CHECK(it != ids.end()) << "Unknown HLO ID " << id;
+    return it->second;
+  };
+  int64 entry_computation_id = module->entry_computation_id();
+  for (auto& computation : *module->mutable_computations()) {
+    int64 new_id = map_id(computation_ids, computation.id());
+    string name = RenumberName(computation.name(), computation.id(), new_id);
+    if (computation.id() == entry_computation_id) {
+      module->set_entry_computation_id(new_id);
+      module->set_entry_computation_name(name);
+    }
+    computation.set_id(new_id);
+    computation.set_name(std::move(name));
+    computation.set_root_id(map_id(instruction_ids, computation.root_id()));
+    for (auto& instruction : *computation.mutable_instructions()) {
+      int64 new_instruction_id = map_id(instruction_ids, instruction.id());
+      instruction.set_name(RenumberName(instruction.name(), instruction.id(),
+                                        new_instruction_id));
+      instruction.set_id(new_instruction_id);
+      for (auto& operand_id : *instruction.mutable_operand_ids()) {
+        operand_id = map_id(instruction_ids, operand_id);
+      }
+      for (auto& predecessor_id :
+           *instruction.mutable_control_predecessor_ids()) {
+        predecessor_id = map_id(instruction_ids, predecessor_id);
+      }
+      for (auto& called_id : *instruction.mutable_called_computation_ids()) {
+        called_id = map_id(computation_ids, called_id);
+      }
+    }
+  }
+  // XlaBuilder gives the module the ID of its entry computation.
+  int64 module_id = module->entry_computation_id();
+  module->set_name(RenumberName(module->name(), module->id(), module_id));
+  module->set_id(module_id);
+}
+
 }  // namespace xrt_util
 }  // namespace xla
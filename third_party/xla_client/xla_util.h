@@ -26,6 +26,12 @@ void CheckComputationStatus(
     const Status& status,
     tensorflow::gtl::ArraySlice<const XlaComputation* const> computations);
 
+// Renumbers the computation and instruction IDs of the module (together with
+// the names derived from them) in order of appearance, so that the same
+// computation gets the same proto no matter when, or in which process, it was
+// built. The operation is idempotent.
+void CanonicalizeHloModule(HloModuleProto* module);
+
 }  // namespace xrt_util
 }  // namespace xla
 
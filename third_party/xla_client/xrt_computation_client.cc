@@ -1,12 +1,17 @@
 #include "tensorflow/compiler/xla/xla_client/xrt_computation_client.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <functional>
 
 #include "absl/strings/str_cat.h"
 #include "absl/types/optional.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
 #include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/buffer_pool.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
@@ -14,15 +19,258 @@
 #include "tensorflow/compiler/xla/xla_client/unique.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "tensorflow/compiler/xla/xla_client/xrt_local_service.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/util/device_name_utils.h"
 
 namespace xla {
+namespace {
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// Returns the LiteralProto field storing the values of the given primitive
+// type, if the wire representation of such values within the field is the raw
+// byte array of their host memory representation. Returns zero otherwise.
+int GetRawLiteralProtoField(PrimitiveType type) {
+  if (!tensorflow::port::kLittleEndian) {
+    return 0;
+  }
+  switch (type) {
+    case PrimitiveType::PRED:
+      return LiteralProto::kPredsFieldNumber;
+    case PrimitiveType::U8:
+      return LiteralProto::kU8SFieldNumber;
+    case PrimitiveType::F16:
+      return LiteralProto::kF16SFieldNumber;
+    case PrimitiveType::BF16:
+      return LiteralProto::kBf16SFieldNumber;
+    case PrimitiveType::F32:
+      return LiteralProto::kF32SFieldNumber;
+    case PrimitiveType::F64:
+      return LiteralProto::kF64SFieldNumber;
+    default:
+      return 0;
+  }
+}
+
+size_t LengthDelimitedHeaderSize(int field, size_t size) {
+  return WireFormatLite::TagSize(field, WireFormatLite::TYPE_BYTES) +
+         CodedOutputStream::VarintSize64(size);
+}
+
+uint8* WriteLengthDelimitedHeader(int field, size_t size, uint8* target) {
+  target = WireFormatLite::WriteTagToArray(
+      field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, target);
+  return CodedOutputStream::WriteVarint64ToArray(size, target);
+}
+
+tensorflow::Tensor CreateAllocationTensor(const LiteralBase& literal) {
+  tensorflow::Tensor tensor(tensorflow::DT_STRING, tensorflow::TensorShape());
+  xrt::XLAAllocation alloc;
+  *alloc.mutable_value() = literal.ToProto();
+  string* alloc_data = &tensor.scalar<string>()();
+  *alloc_data = util::StagingBufferPool::Get()->Acquire(alloc.ByteSizeLong());
+  XLA_CHECK(alloc.SerializeToArray(&(*alloc_data)[0], alloc_data->size()));
+  return tensor;
+}
+
+// Creates the serialized xrt::XLAAllocation for the source tensor. For the
+// types whose LiteralProto field stores the raw values bytes, the protobuf
+// wire format is written by hand, so that the populate_fn callback stores the
+// tensor values once, directly into the feed string. The other types are
+// staged within a pooled buffer, which is then encoded as a LiteralProto.
+tensorflow::Tensor CreateAllocationTensor(
+    const ComputationClient::TensorSource& source) {
+  int field = GetRawLiteralProtoField(source.shape.element_type());
+  if (field == 0) {
+    util::StagingBufferPool* pool = util::StagingBufferPool::Get();
+    string staging = pool->Acquire(ShapeUtil::ByteSizeOf(source.shape));
+    source.populate_fn(source, &staging[0], staging.size());
+    tensorflow::Tensor tensor =
+        CreateAllocationTensor(BorrowingLiteral(staging.data(), source.shape));
+    pool->Release(std::move(staging));
+    return tensor;
+  }
+  string shape_data;
+  XLA_CHECK(source.shape.ToProto().SerializeToString(&shape_data));
+  size_t data_size = ShapeUtil::ByteSizeOf(source.shape);
+  size_t literal_size =
+      LengthDelimitedHeaderSize(LiteralProto::kShapeFieldNumber,
+                                shape_data.size()) +
+      shape_data.size();
+  if (data_size > 0) {
+    literal_size += LengthDelimitedHeaderSize(field, data_size) + data_size;
+  }
+  size_t alloc_size =
+      LengthDelimitedHeaderSize(xrt::XLAAllocation::kValueFieldNumber,
+                                literal_size) +
+      literal_size;
+
+  tensorflow::Tensor tensor(tensorflow::DT_STRING, tensorflow::TensorShape());
+  string* alloc_data = &tensor.scalar<string>()();
+  *alloc_data = util::StagingBufferPool::Get()->Acquire(alloc_size);
+  uint8* target = reinterpret_cast<uint8*>(&(*alloc_data)[0]);
+  target = WriteLengthDelimitedHeader(xrt::XLAAllocation::kValueFieldNumber,
+                                      literal_size, target);
+  target = WriteLengthDelimitedHeader(LiteralProto::kShapeFieldNumber,
+                                      shape_data.size(), target);
+  target = std::copy(shape_data.begin(), shape_data.end(), target);
+  if (data_size > 0) {
+    target = WriteLengthDelimitedHeader(field, data_size, target);
+    source.populate_fn(source, target, data_size);
+    target += data_size;
+  }
+  XLA_CHECK(target ==
+            reinterpret_cast<uint8*>(&(*alloc_data)[0]) + alloc_size);
+  return tensor;
+}
+
+// The values of an array LiteralProto, decoded without copying them out of
+// the serialized proto buffer.
+struct RawLiteral {
+  Shape shape;
+  const void* data = nullptr;
+  size_t size = 0;
+};
+
+uint64 ReadVarint(const uint8** data, const uint8* end) {
+  uint64 value = 0;
+  for (int shift = 0;; shift += 7) {
+    XLA_CHECK(*data < end && shift < 64) << "Malformed LiteralProto varint";
+    uint8 byte = *(*data)++;
+    value |= static_cast<uint64>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
+// Scans the serialized LiteralProto within data, and if it holds an array
+// whose values are stored as raw bytes (see GetRawLiteralProtoField()), fills
+// raw_literal with pointers within data and returns true. Returns false for
+// any other literal, which needs to go through the full proto parsing.
+bool ParseRawLiteral(const string& data, RawLiteral* raw_literal) {
+  const uint8* ptr = reinterpret_cast<const uint8*>(data.data());
+  const uint8* end = ptr + data.size();
+  const uint8* shape_data = nullptr;
+  size_t shape_size = 0;
+  int values_field = 0;
+  const uint8* values_data = nullptr;
+  size_t values_size = 0;
+  while (ptr < end) {
+    uint64 tag = ReadVarint(&ptr, end);
+    if (WireFormatLite::GetTagWireType(tag) !=
+        WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      return false;
+    }
+    uint64 size = ReadVarint(&ptr, end);
+    XLA_CHECK_LE(size, static_cast<uint64>(end - ptr))
+        << "Malformed LiteralProto";
+    int field = WireFormatLite::GetTagFieldNumber(tag);
+    if (field == LiteralProto::kShapeFieldNumber) {
+      shape_data = ptr;
+      shape_size = size;
+    } else if (values_data == nullptr) {
+      values_field = field;
+      values_data = ptr;
+      values_size = size;
+    } else {
+      return false;
+    }
+    ptr += size;
+  }
+  ShapeProto shape_proto;
+  if (shape_data == nullptr ||
+      !shape_proto.ParseFromArray(shape_data, shape_size)) {
+    return false;
+  }
+  Shape shape(shape_proto);
+  if (!shape.IsArray() || ShapeUtil::ByteSizeOf(shape) != values_size ||
+      (values_data != nullptr &&
+       values_field != GetRawLiteralProtoField(shape.element_type()))) {
+    return false;
+  }
+  raw_literal->shape = std::move(shape);
+  raw_literal->data = values_data;
+  raw_literal->size = values_size;
+  return true;
+}
+
+// Creates a computation returning an array of zeros of the given shape.
+XlaComputation CreateZerosComputation(const Shape& shape) {
+  XlaBuilder builder("Zeros");
+  Broadcast(ConstantLiteral(&builder, LiteralUtil::Zero(shape.element_type())),
+            shape.dimensions());
+  return builder.Build().ConsumeValueOrDie();
+}
+
+// Returns the host memory held by a compiled computation, which is mostly
+// taken by its HLO module proto.
+size_t GetComputationHostBytes(
+    const std::shared_ptr<ComputationClient::Computation>& computation) {
+  return computation->computation().proto().ByteSizeLong();
+}
+
+metrics::Metric* CompilationCacheResidentBytesMetric() {
+  static metrics::Metric* metric = new metrics::Metric(
+      "CompilationCacheResidentBytes", metrics::MetricFnBytes);
+  return metric;
+}
+
+metrics::Metric* CompilationWarmUpMetric() {
+  static metrics::Metric* metric =
+      new metrics::Metric("CompilationWarmUpTime", metrics::MetricFnTime);
+  return metric;
+}
+
+// Allocations smaller than this are packed together within the same
+// conversion closure, up to this total size.
+constexpr int64 kMinConversionBatchBytes = 1024 * 1024;
+
+// Splits the [0, count) allocation indices into consecutive [start, end)
+// batches, each converted by a single thread pool closure. Allocations of
+// unknown size, or large ones, get a closure of their own (the conversion of
+// large tensors is further split over the thread pool by the populate_fn
+// callbacks).
+std::vector<std::pair<size_t, size_t>> GetConversionBatches(
+    size_t count, const std::function<int64(size_t)>& size_fn) {
+  std::vector<std::pair<size_t, size_t>> batches;
+  size_t start = 0;
+  int64 batch_size = 0;
+  for (size_t i = 0; i < count; ++i) {
+    int64 size = size_fn(i);
+    if (size < 0 || size >= kMinConversionBatchBytes) {
+      if (start < i) {
+        batches.emplace_back(start, i);
+      }
+      batches.emplace_back(i, i + 1);
+      start = i + 1;
+      batch_size = 0;
+    } else {
+      batch_size += size;
+      if (batch_size >= kMinConversionBatchBytes) {
+        batches.emplace_back(start, i + 1);
+        start = i + 1;
+        batch_size = 0;
+      }
+    }
+  }
+  if (start < count) {
+    batches.emplace_back(start, count);
+  }
+  return batches;
+}
+
+}  // namespace
 
 XrtComputationClient::XrtComputationClient(
     XrtComputationClient::Options options)
     : options_(std::move(options)),
       compilation_cache_(
-          sys_util::GetEnvInt("XLA_COMPILATION_CACHE_SIZE", 64)) {
+          sys_util::GetEnvInt("XLA_COMPILATION_CACHE_SIZE", 64),
+          sys_util::GetEnvInt("XLA_COMPILATION_CACHE_BYTES", 1LL << 30),
+          GetComputationHostBytes) {
   auto default_device_target =
       options_.device_map.find(options_.default_device);
   XLA_CHECK(default_device_target != options_.device_map.end());
@@ -34,6 +282,7 @@ XrtComputationClient::XrtComputationClient(
   MaybeCreateLocalService(options_);
   InitializeDevices();
   StartHandleReleaser();
+  InitializeCompilationManifest();
 }
 
 std::vector<std::shared_ptr<ComputationClient::Data>>
@@ -41,38 +290,102 @@ XrtComputationClient::TransferToServer(
     tensorflow::gtl::ArraySlice<const LiteralDevice> literals) {
   metrics::TimedSection timed(TransferToServerMetric());
 
+  auto alloc_fn = [&](size_t i, std::vector<string>* devices, Shape* shape) {
+    Literal literal_storage;
+    const Literal& literal = literals[i].GetLiteral(&literal_storage);
+    devices->push_back(literals[i].device);
+    *shape = literal.shape();
+    return CreateAllocationTensor(literal);
+  };
+  auto size_fn = [&](size_t i) -> int64 {
+    return literals[i].literal ? literals[i].literal->size_bytes() : -1;
+  };
+  return GetSingleDeviceResults(
+      TransferAllocations(literals.size(), size_fn, alloc_fn));
+}
+
+std::vector<std::shared_ptr<ComputationClient::Data>>
+XrtComputationClient::TransferTensorsToServer(
+    tensorflow::gtl::ArraySlice<const TensorSource> tensors) {
+  metrics::TimedSection timed(TransferToServerMetric());
+
+  auto alloc_fn = [&](size_t i, std::vector<string>* devices, Shape* shape) {
+    devices->push_back(tensors[i].device);
+    *shape = tensors[i].shape;
+    return CreateAllocationTensor(tensors[i]);
+  };
+  auto size_fn = [&](size_t i) -> int64 {
+    return ShapeUtil::ByteSizeOf(tensors[i].shape);
+  };
+  return GetSingleDeviceResults(
+      TransferAllocations(tensors.size(), size_fn, alloc_fn));
+}
+
+std::vector<std::vector<std::shared_ptr<ComputationClient::Data>>>
+XrtComputationClient::BroadcastTensorsToServer(
+    tensorflow::gtl::ArraySlice<const TensorSource> tensors,
+    tensorflow::gtl::ArraySlice<const string> devices) {
+  metrics::TimedSection timed(TransferToServerMetric());
+
+  auto alloc_fn = [&](size_t i, std::vector<string>* alloc_devices,
+                      Shape* shape) {
+    alloc_devices->assign(devices.begin(), devices.end());
+    *shape = tensors[i].shape;
+    return CreateAllocationTensor(tensors[i]);
+  };
+  auto size_fn = [&](size_t i) -> int64 {
+    return ShapeUtil::ByteSizeOf(tensors[i].shape);
+  };
+  return TransferAllocations(tensors.size(), size_fn, alloc_fn);
+}
+
+std::vector<std::vector<std::shared_ptr<ComputationClient::Data>>>
+XrtComputationClient::TransferAllocations(
+    size_t count, const std::function<int64(size_t)>& size_fn,
+    const std::function<tensorflow::Tensor(size_t, std::vector<string>*,
+                                           Shape*)>& alloc_fn) {
   std::mutex lock;
   XrtSessionCache::SessionMap session_map;
   int64 total_size = 0;
-  xla_util::MultiWait mwait(literals.size());
+  std::vector<std::pair<size_t, size_t>> batches =
+      GetConversionBatches(count, size_fn);
+  xla_util::MultiWait mwait(batches.size());
   std::map<XrtSession*, SessionWork> session_work_map;
-  std::vector<Literal> literals_storage(literals.size());
-  std::vector<const Literal*> literals_ptrs(literals.size());
-  for (size_t i = 0; i < literals.size(); ++i) {
-    auto converter = [&, i]() {
-      const Literal& literal = literals[i].GetLiteral(&literals_storage[i]);
-      literals_ptrs[i] = &literal;
-
-      string device = GetEffectiveDevice(literals[i].device);
-      const string& xrt_device = TorchDeviceToXrtDevice(device);
-      xrt::XLAAllocation alloc;
-      *alloc.mutable_value() = literal.ToProto();
-      tensorflow::Input::Initializer feed_value(alloc.SerializeAsString());
+  // For every session, the index of the allocation device fed by each of the
+  // session_work.index_mapping entries.
+  std::map<XrtSession*, std::vector<size_t>> device_mapping;
+  std::vector<std::vector<string>> devices(count);
+  std::vector<Shape> shapes(count);
+  std::vector<tensorflow::Tensor> alloc_tensors(count);
+  for (auto& batch : batches) {
+    auto converter = [&, batch]() {
+      for (size_t i = batch.first; i < batch.second; ++i) {
+        alloc_tensors[i] = alloc_fn(i, &devices[i], &shapes[i]);
+        for (auto& device : devices[i]) {
+          device = GetEffectiveDevice(device);
+        }
+      }
 
-      {
-        std::lock_guard<std::mutex> slock(lock);
-        XrtSession* session = GetSessionForXrtDevice(xrt_device, &session_map);
-        SessionWork* session_work = &session_work_map[session];
-        tensorflow::Scope device_scope =
-            session->root()->WithDevice(xrt_device);
-        const XrtSession::CachedNode& cached_node =
-            GetAllocateNode(session, device_scope, device);
-        session_work->feed_inputs.insert(
-            {cached_node.holders[0], std::move(feed_value)});
-        session_work->outputs_handles.push_back(cached_node.outputs[0]);
-        session_work->index_mapping.push_back(i);
+      std::lock_guard<std::mutex> slock(lock);
+      for (size_t i = batch.first; i < batch.second; ++i) {
+        for (size_t j = 0; j < devices[i].size(); ++j) {
+          const string& xrt_device = TorchDeviceToXrtDevice(devices[i][j]);
+          XrtSession* session =
+              GetSessionForXrtDevice(xrt_device, &session_map);
+          SessionWork* session_work = &session_work_map[session];
+          tensorflow::Scope device_scope =
+              session->root()->WithDevice(xrt_device);
+          const XrtSession::CachedNode& cached_node =
+              GetAllocateNode(session, device_scope, devices[i][j]);
+          session_work->feed_inputs.insert(
+              {cached_node.holders[0],
+               tensorflow::Input::Initializer(alloc_tensors[i])});
+          session_work->outputs_handles.push_back(cached_node.outputs[0]);
+          session_work->index_mapping.push_back(i);
+          device_mapping[session].push_back(j);
 
-        total_size += literal.size_bytes();
+          total_size += ShapeUtil::ByteSizeOf(shapes[i], sizeof(void*));
+        }
       }
     };
     xla_env::ScheduleClosure(mwait.Completer(std::move(converter)));
@@ -81,7 +394,10 @@ XrtComputationClient::TransferToServer(
 
   OutboundDataMetric()->AddSample(total_size);
 
-  std::vector<std::shared_ptr<Data>> results(literals.size());
+  std::vector<std::vector<std::shared_ptr<Data>>> results(count);
+  for (size_t i = 0; i < count; ++i) {
+    results[i].resize(devices[i].size());
+  }
   for (auto& session_work : session_work_map) {
     std::vector<tensorflow::Tensor> outputs;
     XLA_CHECK_OK(session_work.first->session()->Run(
@@ -89,21 +405,156 @@ XrtComputationClient::TransferToServer(
         &outputs));
     XLA_CHECK_EQ(outputs.size(), session_work.second.outputs_handles.size());
 
+    const std::vector<size_t>& session_devices =
+        device_mapping[session_work.first];
     for (size_t i = 0; i < outputs.size(); ++i) {
       size_t li = session_work.second.index_mapping[i];
-      results[li] = std::make_shared<XrtData>(
-          this, GetEffectiveDevice(literals[li].device),
-          literals_ptrs[li]->shape(), outputs[i].scalar<int64>()());
+      size_t dj = session_devices[i];
+      results[li][dj] = std::make_shared<XrtData>(
+          this, devices[li][dj], shapes[li], outputs[i].scalar<int64>()());
     }
     CreateDataHandlesCounter()->AddValue(outputs.size());
   }
+  // Once the session feeds are gone, the allocation tensors are the only
+  // owners of the serialized data, whose buffers can go back to the pool.
+  session_work_map.clear();
+  util::StagingBufferPool* pool = util::StagingBufferPool::Get();
+  for (auto& alloc_tensor : alloc_tensors) {
+    pool->Release(std::move(alloc_tensor.scalar<string>()()));
+  }
   return results;
 }
 
+std::vector<std::shared_ptr<ComputationClient::Data>>
+XrtComputationClient::GetSingleDeviceResults(
+    std::vector<std::vector<std::shared_ptr<Data>>> results) {
+  std::vector<std::shared_ptr<Data>> single_results;
+  single_results.reserve(results.size());
+  for (auto& result : results) {
+    XLA_CHECK_EQ(result.size(), 1);
+    single_results.push_back(std::move(result.front()));
+  }
+  return single_results;
+}
+
 std::vector<Literal> XrtComputationClient::TransferFromServer(
     tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles) {
   metrics::TimedSection timed(TransferFromServerMetric());
 
+  int64 total_size = 0;
+  std::vector<Literal> results(handles.size());
+  auto read_fn = [&](size_t i, const string& data) {
+    LiteralProto response;
+    XLA_CHECK(response.ParseFromString(data));
+    results[i] = std::move(Literal::CreateFromProto(response).ValueOrDie());
+    total_size += results[i].size_bytes();
+  };
+  ReadHandles(handles, read_fn);
+  InboundDataMetric()->AddSample(total_size);
+  return results;
+}
+
+void XrtComputationClient::TransferTensorsFromServer(
+    tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles,
+    const TensorConsumerFn& consumer_fn) {
+  metrics::TimedSection timed(TransferFromServerMetric());
+
+  int64 total_size = 0;
+  auto read_fn = [&](size_t i, const string& data) {
+    RawLiteral raw_literal;
+    if (ParseRawLiteral(data, &raw_literal)) {
+      consumer_fn(i, raw_literal.shape, raw_literal.data, raw_literal.size);
+      total_size += raw_literal.size;
+    } else {
+      LiteralProto response;
+      XLA_CHECK(response.ParseFromString(data));
+      Literal literal = Literal::CreateFromProto(response).ValueOrDie();
+      XLA_CHECK(literal.shape().IsArray()) << literal.shape();
+      consumer_fn(i, literal.shape(), literal.untyped_data(),
+                  literal.size_bytes());
+      total_size += literal.size_bytes();
+    }
+  };
+  ReadHandles(handles, read_fn);
+  InboundDataMetric()->AddSample(total_size);
+}
+
+std::vector<std::shared_ptr<ComputationClient::Data>>
+XrtComputationClient::TransferBetweenDevices(
+    tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles,
+    tensorflow::gtl::ArraySlice<const string> devices) {
+  metrics::TimedSection timed(TransferBetweenDevicesMetric());
+  XLA_CHECK_EQ(handles.size(), devices.size());
+
+  // XRT has no allocation copy operation, so the destination allocations are
+  // created by computations returning zeros of the source shapes (with their
+  // layouts), and then overwritten with the source data. The source data is
+  // read within the same session run, on the source device, and goes straight
+  // from the source to the destination worker. Compile() caches the zeros
+  // computations, so they are only built on the servers once.
+  std::vector<string> effective_devices;
+  std::vector<CompileInstance> instances;
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const Shape& shape = handles[i]->shape();
+    XLA_CHECK(shape.IsArray()) << shape;
+    effective_devices.push_back(GetEffectiveDevice(devices[i]));
+    instances.emplace_back(CreateZerosComputation(shape),
+                           std::vector<string>({effective_devices.back()}),
+                           &shape);
+  }
+  std::vector<std::shared_ptr<Computation>> computations =
+      Compile(std::move(instances));
+
+  string exec_config = GetExecutionConfig(ExecuteOptions());
+  tensorflow::Tensor no_inputs(tensorflow::DT_INT64,
+                               tensorflow::TensorShape({0}));
+  XrtSessionCache::SessionMap session_map;
+  std::map<XrtSession*, SessionWork> session_work_map;
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const XrtData& xrt_data = dynamic_cast<const XrtData&>(*handles[i]);
+    const XrtComputation& xrt_computation =
+        dynamic_cast<const XrtComputation&>(*computations[i]);
+    string source_device = GetEffectiveDevice(xrt_data.device());
+    const string& xrt_device = TorchDeviceToXrtDevice(effective_devices[i]);
+    XrtSession* session = GetSessionForXrtDevice(xrt_device, &session_map);
+    SessionWork* session_work = &session_work_map[session];
+    tensorflow::Scope source_scope =
+        session->root()->WithDevice(TorchDeviceToXrtDevice(source_device));
+    tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+    const XrtSession::CachedNode& cached_node =
+        GetTransferNode(session, source_scope, source_device, device_scope,
+                        effective_devices[i]);
+    session_work->feed_inputs.insert({cached_node.holders[0], xrt_data.handle});
+    session_work->feed_inputs.insert(
+        {cached_node.holders[1], xrt_computation.handle});
+    session_work->feed_inputs.insert({cached_node.holders[2], exec_config});
+    session_work->feed_inputs.insert({cached_node.holders[3], no_inputs});
+    session_work->outputs_handles.push_back(cached_node.outputs[0]);
+    session_work->index_mapping.push_back(i);
+  }
+
+  std::vector<std::shared_ptr<Data>> results(handles.size());
+  for (auto& session_work : session_work_map) {
+    std::vector<tensorflow::Tensor> outputs;
+    XLA_CHECK_OK(session_work.first->session()->Run(
+        session_work.second.feed_inputs, session_work.second.outputs_handles,
+        &outputs));
+    XLA_CHECK_EQ(outputs.size(), session_work.second.outputs_handles.size());
+
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      size_t li = session_work.second.index_mapping[i];
+      results[li] = std::make_shared<XrtData>(this, effective_devices[li],
+                                              handles[li]->shape(),
+                                              outputs[i].scalar<int64>()());
+    }
+    CreateDataHandlesCounter()->AddValue(outputs.size());
+  }
+  return results;
+}
+
+void XrtComputationClient::ReadHandles(
+    tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles,
+    const std::function<void(size_t, const string&)>& read_fn) {
   XrtSessionCache::SessionMap session_map;
   std::map<XrtSession*, SessionWork> session_work_map;
   for (size_t i = 0; i < handles.size(); ++i) {
@@ -119,8 +570,6 @@ std::vector<Literal> XrtComputationClient::TransferFromServer(
     session_work->index_mapping.push_back(i);
   }
 
-  int64 total_size = 0;
-  std::vector<Literal> results(handles.size());
   for (auto& session_work : session_work_map) {
     std::vector<tensorflow::Tensor> outputs;
     XLA_CHECK_OK(session_work.first->session()->Run(
@@ -129,15 +578,10 @@ std::vector<Literal> XrtComputationClient::TransferFromServer(
     XLA_CHECK_EQ(outputs.size(), session_work.second.outputs_handles.size());
 
     for (size_t i = 0; i < outputs.size(); ++i) {
-      size_t li = session_work.second.index_mapping[i];
-      LiteralProto response;
-      XLA_CHECK(response.ParseFromString(outputs[i].scalar<string>()()));
-      results[li] = std::move(Literal::CreateFromProto(response).ValueOrDie());
-      total_size += results[li].size_bytes();
+      read_fn(session_work.second.index_mapping[i],
+              outputs[i].scalar<string>()());
     }
   }
-  InboundDataMetric()->AddSample(total_size);
-  return results;
 }
 
 std::vector<std::shared_ptr<ComputationClient::Computation>>
@@ -148,46 +592,95 @@ XrtComputationClient::Compile(std::vector<CompileInstance> instances) {
   xla_util::MultiWait mwait(instances.size());
   std::vector<ProgramShape> program_shapes(instances.size());
   std::vector<std::shared_ptr<Computation>> results(instances.size());
-  std::vector<string> serialized_computations(instances.size());
+  std::vector<tensorflow::Fprint128> cache_keys(instances.size());
+  // The in flight compilations started by this call, and the ones (started
+  // either by this or by other calls) which this call waits for.
+  std::vector<std::shared_ptr<InFlightCompile>> started(instances.size());
+  std::vector<std::shared_ptr<InFlightCompile>> waited(instances.size());
   XrtSessionCache::SessionMap session_map;
   std::map<XrtSession*, SessionWork> session_work_map;
+  // Removes an in flight compilation started by this call, and wakes up its
+  // waiters, which receive either the computation or the error status.
+  auto complete_compile = [&, this](size_t i, const Status& status) {
+    {
+      std::lock_guard<std::mutex> slock(compiling_lock_);
+      compiling_.erase(cache_keys[i]);
+    }
+    {
+      std::lock_guard<std::mutex> slock(started[i]->mutex);
+      started[i]->done = true;
+      started[i]->status = status;
+      started[i]->computation = results[i];
+    }
+    started[i]->cv.notify_all();
+    started[i] = nullptr;
+  };
   for (size_t i = 0; i < instances.size(); ++i) {
     auto builder = [&, this, i]() {
       const CompileInstance& instance = instances[i];
       std::unique_ptr<xrt::XLAComputation> xrt_computation =
           CreateXrtComputation(instance.computation, instance.devices,
                                instance.output_shape);
-      string serialized_computation = xrt_computation->SerializeAsString();
-
-      auto computation_ptr = compilation_cache_.Get(serialized_computation);
-      if (computation_ptr == nullptr) {
-        serialized_computations[i] = std::move(serialized_computation);
-        program_shapes[i] =
-            ProgramShape(xrt_computation->config().program_shape());
-
-        string compilation_device = GetCompilationDevice(instance.devices);
-        const string& xrt_device = TorchDeviceToXrtDevice(compilation_device);
-        {
-          std::lock_guard<std::mutex> slock(lock);
-          XrtSession* session =
-              GetSessionForXrtDevice(xrt_device, &session_map);
-          SessionWork* session_work = &session_work_map[session];
-          tensorflow::Scope device_scope =
-              session->root()->WithDevice(xrt_device);
-          const XrtSession::CachedNode& cached_node =
-              GetCompileNode(session, device_scope, compilation_device);
-          session_work->feed_inputs.insert(
-              {cached_node.holders[0], serialized_computations[i]});
-          session_work->outputs_handles.push_back(cached_node.outputs[0]);
-          session_work->index_mapping.push_back(i);
+      // The serialized computation is only kept alive by the compile feed,
+      // and goes away once the compilation is done.
+      tensorflow::Tensor serialized_computation(tensorflow::DT_STRING,
+                                                tensorflow::TensorShape());
+      XLA_CHECK(xrt_computation->SerializeToString(
+          &serialized_computation.scalar<string>()()));
+      cache_keys[i] = GetCompilationCacheKey(
+          serialized_computation.scalar<string>()(), instance.devices);
+      if (compilation_manifest_ != nullptr) {
+        compilation_manifest_->Record(cache_keys[i],
+                                      serialized_computation.scalar<string>()(),
+                                      instance.devices);
+      }
+
+      {
+        std::lock_guard<std::mutex> slock(compiling_lock_);
+        // Completed compilations are added to the cache before being removed
+        // from the in flight map, so checking the cache while holding the
+        // in flight map lock cannot miss both.
+        auto computation_ptr = compilation_cache_.Get(cache_keys[i]);
+        if (computation_ptr != nullptr) {
+          XLA_COUNTER("CompilationCacheHits", 1);
+          results[i] = *computation_ptr;
+          return;
         }
-      } else {
-        results[i] = *computation_ptr;
+        XLA_COUNTER("CompilationCacheMisses", 1);
+        auto it = compiling_.find(cache_keys[i]);
+        if (it != compiling_.end()) {
+          XLA_COUNTER("CompilationsDeduplicated", 1);
+          waited[i] = it->second;
+          return;
+        }
+        started[i] = std::make_shared<InFlightCompile>();
+        compiling_.emplace(cache_keys[i], started[i]);
+      }
+      program_shapes[i] =
+          ProgramShape(xrt_computation->config().program_shape());
+
+      string compilation_device = GetCompilationDevice(instance.devices);
+      const string& xrt_device = TorchDeviceToXrtDevice(compilation_device);
+      {
+        std::lock_guard<std::mutex> slock(lock);
+        XrtSession* session = GetSessionForXrtDevice(xrt_device, &session_map);
+        SessionWork* session_work = &session_work_map[session];
+        tensorflow::Scope device_scope =
+            session->root()->WithDevice(xrt_device);
+        const XrtSession::CachedNode& cached_node =
+            GetCompileNode(session, device_scope, compilation_device);
+        session_work->feed_inputs.insert(
+            {cached_node.holders[0], serialized_computation});
+        session_work->outputs_handles.push_back(cached_node.outputs[0]);
+        session_work->index_mapping.push_back(i);
       }
     };
     xla_env::ScheduleClosure(mwait.Completer(std::move(builder)));
   }
-  TF_CHECK_OK(mwait.Wait());
+  Status status = mwait.Wait();
+  if (!status.ok()) {
+    session_work_map.clear();
+  }
   mwait.Reset(session_work_map.size());
 
   for (auto& session_and_work : session_work_map) {
@@ -210,14 +703,47 @@ XrtComputationClient::Compile(std::vector<CompileInstance> instances) {
             GetCompilationDevice(instance->devices));
         ++output_index;
 
-        compilation_cache_.Add(std::move(serialized_computations[li]),
-                               results[li]);
+        // Evicted computations release their server side compile handles,
+        // once no one else is holding them.
+        size_t evicted = compilation_cache_.Add(cache_keys[li], results[li]);
+        if (evicted > 0) {
+          XLA_COUNTER("CompilationCacheEvictions", evicted);
+        }
+        CompilationCacheResidentBytesMetric()->AddSample(
+            compilation_cache_.Weight());
         CreateCompileHandlesCounter()->AddValue(1);
+        complete_compile(li, Status::OK());
       }
     };
     xla_env::ScheduleIoClosure(mwait.Completer(std::move(session_runner)));
   }
-  TF_CHECK_OK(mwait.Wait());
+  if (status.ok()) {
+    status = mwait.Wait();
+  }
+  // Whatever failed, the compilations started by this call and not completed
+  // yet must be completed with an error, or their waiters would hang forever.
+  for (size_t i = 0; i < instances.size(); ++i) {
+    if (started[i] != nullptr) {
+      complete_compile(i, status.ok() ? tensorflow::errors::Internal(
+                                            "Compilation not completed")
+                                      : status);
+    }
+  }
+  XLA_CHECK_OK(status);
+
+  // Only wait for the other compilations after having completed the ones
+  // started by this call, which others might be waiting for.
+  for (size_t i = 0; i < instances.size(); ++i) {
+    if (waited[i] != nullptr) {
+      std::unique_lock<std::mutex> ulock(waited[i]->mutex);
+      waited[i]->cv.wait(ulock, [&] { return waited[i]->done; });
+      XLA_CHECK_OK(waited[i]->status);
+      results[i] = waited[i]->computation;
+    }
+  }
+  if (compilation_manifest_ != nullptr) {
+    compilation_manifest_->MaybeFlush();
+  }
   return results;
 }
 
@@ -233,8 +759,8 @@ XrtComputationClient::ExecuteComputation(
   tensorflow::ClientSession::FeedType feed_inputs;
   std::vector<tensorflow::Output> exec_ops = CreateExecuteOps(
       &session_map, dynamic_cast<const XrtComputation&>(computation),
-      BuildParallelArguments(arguments), options.explode_tuple,
-      {effective_device}, &feed_inputs);
+      BuildParallelArguments(arguments), options, {effective_device},
+      &feed_inputs);
 
   XrtSession* session = GetSessionForDevice(effective_device, &session_map);
   std::vector<tensorflow::Tensor> outputs;
@@ -259,7 +785,7 @@ XrtComputationClient::ExecuteReplicated(
   tensorflow::ClientSession::FeedType feed_inputs;
   std::vector<tensorflow::Output> exec_ops = CreateExecuteOps(
       &session_map, dynamic_cast<const XrtComputation&>(computation), arguments,
-      options.explode_tuple, devices, &feed_inputs);
+      options, devices, &feed_inputs);
   std::vector<const Computation*> computations(devices.size());
   std::fill(computations.begin(), computations.end(), &computation);
 
@@ -338,12 +864,108 @@ XrtComputationClient::ExecuteParallel(
   XrtSessionCache::SessionMap session_map;
   tensorflow::ClientSession::FeedType feed_inputs;
   std::vector<tensorflow::Output> exec_ops =
-      CreateExecuteOps(&session_map, computations, arguments,
-                       options.explode_tuple, devices, &feed_inputs);
+      CreateExecuteOps(&session_map, computations, arguments, options, devices,
+                       &feed_inputs);
   return RunComputations(session_map, exec_ops, computations, devices,
                          feed_inputs);
 }
 
+std::vector<std::vector<std::shared_ptr<ComputationClient::Data>>>
+XrtComputationClient::ExecuteParallelAndFetch(
+    tensorflow::gtl::ArraySlice<const Computation* const> computations,
+    const std::vector<std::vector<Data*>>& arguments,
+    tensorflow::gtl::ArraySlice<const string> devices,
+    const std::vector<std::vector<int64>>& fetch_indices,
+    std::vector<std::vector<Literal>>* literals,
+    const ExecuteParallelOptions& options) {
+  metrics::TimedSection timed(ExecuteParallelAndFetchMetric());
+  XLA_CHECK_EQ(computations.size(), devices.size());
+  XLA_CHECK_EQ(fetch_indices.size(), devices.size());
+
+  XrtSessionCache::SessionMap session_map;
+  tensorflow::ClientSession::FeedType feed_inputs;
+  std::vector<const XrtSession::CachedNode*> cached_nodes;
+  std::map<XrtSession*, std::vector<size_t>> session_replicas;
+  for (size_t i = 0; i < computations.size(); ++i) {
+    const XrtComputation* xrt_computation =
+        dynamic_cast<const XrtComputation*>(computations[i]);
+    auto inputs = GetArgumentsInputs(arguments[i], devices[i], &feed_inputs);
+    const string& xrt_device = TorchDeviceToXrtDevice(devices[i]);
+    XrtSession* session = GetSessionForXrtDevice(xrt_device, &session_map);
+    tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+    const XrtSession::CachedNode& cached_node =
+        GetExecuteReadNode(session, device_scope, devices[i],
+                           options.explode_tuple, fetch_indices[i].size());
+    feed_inputs.insert({cached_node.holders[0], xrt_computation->handle});
+    feed_inputs.insert({cached_node.holders[1], GetExecutionConfig(options)});
+    feed_inputs.insert({cached_node.holders[2], inputs});
+    for (size_t j = 0; j < fetch_indices[i].size(); ++j) {
+      if (options.explode_tuple) {
+        tensorflow::Tensor index_tensor(tensorflow::DT_INT32,
+                                        tensorflow::TensorShape());
+        index_tensor.scalar<tensorflow::int32>()() = fetch_indices[i][j];
+        feed_inputs.insert({cached_node.holders[3 + j], index_tensor});
+      } else {
+        XLA_CHECK_EQ(fetch_indices[i][j], 0);
+      }
+    }
+    if (options.release_input_handles) {
+      DonateArguments(arguments[i]);
+    }
+    cached_nodes.push_back(&cached_node);
+    session_replicas[session].push_back(i);
+  }
+
+  xla_util::MultiWait mwait(session_replicas.size());
+  std::atomic<int64> total_size(0);
+  std::vector<std::vector<std::shared_ptr<Data>>> results(devices.size());
+  literals->clear();
+  literals->resize(devices.size());
+  for (auto& sess_replica : session_replicas) {
+    XrtSession* session = sess_replica.first;
+    const std::vector<size_t>& replicas = sess_replica.second;
+
+    auto session_runner = [&, this, session]() {
+      std::vector<tensorflow::Output> outputs_handles;
+      std::vector<const XlaComputation*> xla_computations;
+      for (auto replica : replicas) {
+        outputs_handles.insert(outputs_handles.end(),
+                               cached_nodes[replica]->outputs.begin(),
+                               cached_nodes[replica]->outputs.end());
+        xla_computations.push_back(&computations[replica]->computation());
+      }
+      std::vector<tensorflow::Tensor> outputs;
+      xrt_util::CheckComputationStatus(
+          session->session()->Run(feed_inputs, outputs_handles, &outputs),
+          xla_computations);
+      XLA_CHECK_EQ(outputs.size(), outputs_handles.size());
+
+      size_t output_index = 0;
+      for (auto replica : replicas) {
+        results[replica] = GetComputationResults(
+            outputs[output_index],
+            computations[replica]->program_shape().result(),
+            GetEffectiveDevice(devices[replica]));
+        ++output_index;
+        std::vector<Literal>* replica_literals = &(*literals)[replica];
+        for (size_t j = 0; j < fetch_indices[replica].size();
+             ++j, ++output_index) {
+          LiteralProto response;
+          XLA_CHECK(response.ParseFromString(
+              outputs[output_index].scalar<string>()()));
+          replica_literals->push_back(
+              Literal::CreateFromProto(response).ValueOrDie());
+          total_size += replica_literals->back().size_bytes();
+        }
+      }
+    };
+    xla_env::ScheduleIoClosure(mwait.Completer(std::move(session_runner)));
+  }
+  TF_CHECK_OK(mwait.Wait());
+  InboundDataMetric()->AddSample(total_size.load());
+  return results;
+}
+
 std::vector<std::vector<std::shared_ptr<ComputationClient::Data>>>
 XrtComputationClient::DeconstructTuple(
     tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> tuples) {
@@ -443,6 +1065,23 @@ string XrtComputationClient::GetCompilationDevice(
   return devices.empty() ? GetDefaultDevice() : devices[0];
 }
 
+tensorflow::Fprint128 XrtComputationClient::GetCompilationCacheKey(
+    const string& serialized_computation,
+    tensorflow::gtl::ArraySlice<const string> devices) const {
+  // Single device computations do not carry their device within the
+  // serialized computation, so the devices are always part of the key.
+  string devices_key;
+  for (auto& device : devices) {
+    absl::StrAppend(&devices_key, GetEffectiveDevice(device), ";");
+  }
+  tensorflow::Fprint128 computation_fp =
+      tensorflow::Fingerprint128(serialized_computation);
+  tensorflow::Fprint128 devices_fp = tensorflow::Fingerprint128(devices_key);
+  return {tensorflow::FingerprintCat64(computation_fp.low64, devices_fp.low64),
+          tensorflow::FingerprintCat64(computation_fp.high64,
+                                       devices_fp.high64)};
+}
+
 std::unique_ptr<xrt::XLAComputation> XrtComputationClient::CreateXrtComputation(
     const XlaComputation& computation,
     tensorflow::gtl::ArraySlice<const string> devices,
@@ -472,6 +1111,11 @@ std::unique_ptr<xrt::XLAComputation> XrtComputationClient::CreateXrtComputation(
   }
   *xrt_computation->mutable_hlo_snapshot() =
       std::move(*computation.Snapshot().ConsumeValueOrDie());
+  // Strip the process specific IDs, so that the cache keys of the same
+  // computation match across graph rebuilds and processes.
+  xrt_util::CanonicalizeHloModule(xrt_computation->mutable_hlo_snapshot()
+                                      ->mutable_hlo()
+                                      ->mutable_hlo_module());
   return xrt_computation;
 }
 
@@ -488,10 +1132,30 @@ tensorflow::Tensor XrtComputationClient::GetArgumentsInputs(
   return inputs_tensor;
 }
 
+void XrtComputationClient::DonateArguments(
+    tensorflow::gtl::ArraySlice<Data*> arguments) {
+  for (auto argument : arguments) {
+    XrtData* xrt_data = dynamic_cast<XrtData*>(argument);
+    XLA_CHECK(xrt_data->Release()) << "Donating an already released handle";
+  }
+  DonateDataHandlesCounter()->AddValue(arguments.size());
+}
+
+string XrtComputationClient::GetExecutionConfig(
+    const ExecuteOptions& options) {
+  xrt::XRTExecutionConfig exec_config;
+  exec_config.set_core_index_in_replica(0);
+  exec_config.set_release_input_handles(options.release_input_handles);
+  exec_config.set_release_compilation_handle(false);
+  exec_config.set_return_exploded_tuple(options.explode_tuple);
+  return exec_config.SerializeAsString();
+}
+
 std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
     XrtSessionCache::SessionMap* session_map,
     tensorflow::gtl::ArraySlice<const Computation* const> computations,
-    const std::vector<std::vector<Data*>>& arguments, bool explode_tuple,
+    const std::vector<std::vector<Data*>>& arguments,
+    const ExecuteOptions& options,
     tensorflow::gtl::ArraySlice<const string> devices,
     tensorflow::ClientSession::FeedType* feed_inputs) {
   std::vector<tensorflow::Output> exec_ops;
@@ -506,13 +1170,10 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
         GetExecuteNode(session, device_scope, devices[i]);
     feed_inputs->insert({cached_node.holders[0], xrt_computation->handle});
 
-    xrt::XRTExecutionConfig exec_config;
-    exec_config.set_core_index_in_replica(0);
-    exec_config.set_release_input_handles(false);
-    exec_config.set_release_compilation_handle(false);
-    exec_config.set_return_exploded_tuple(explode_tuple);
-    feed_inputs->insert(
-        {cached_node.holders[1], exec_config.SerializeAsString()});
+    if (options.release_input_handles) {
+      DonateArguments(arguments[i]);
+    }
+    feed_inputs->insert({cached_node.holders[1], GetExecutionConfig(options)});
     feed_inputs->insert({cached_node.holders[2], inputs});
 
     exec_ops.push_back(cached_node.outputs[0]);
@@ -522,7 +1183,8 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
 
 std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
     XrtSessionCache::SessionMap* session_map, const XrtComputation& computation,
-    const std::vector<std::vector<Data*>>& arguments, bool explode_tuple,
+    const std::vector<std::vector<Data*>>& arguments,
+    const ExecuteOptions& options,
     tensorflow::gtl::ArraySlice<const string> devices,
     tensorflow::ClientSession::FeedType* feed_inputs) {
   std::vector<tensorflow::Output> exec_ops;
@@ -535,13 +1197,10 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
         GetExecuteNode(session, device_scope, devices[i]);
     feed_inputs->insert({cached_node.holders[0], computation.handle});
 
-    xrt::XRTExecutionConfig exec_config;
-    exec_config.set_core_index_in_replica(0);
-    exec_config.set_release_input_handles(false);
-    exec_config.set_release_compilation_handle(false);
-    exec_config.set_return_exploded_tuple(explode_tuple);
-    feed_inputs->insert(
-        {cached_node.holders[1], exec_config.SerializeAsString()});
+    if (options.release_input_handles) {
+      DonateArguments(arguments[i]);
+    }
+    feed_inputs->insert({cached_node.holders[1], GetExecutionConfig(options)});
     feed_inputs->insert({cached_node.holders[2], inputs});
 
     exec_ops.push_back(cached_node.outputs[0]);
@@ -601,6 +1260,51 @@ void XrtComputationClient::StartHandleReleaser() {
       new xla_util::TriggeredTask([this]() { HandleReleaser(); }, num_threads));
 }
 
+void XrtComputationClient::InitializeCompilationManifest() {
+  string path = sys_util::GetEnvString("XLA_COMPILATION_MANIFEST", "");
+  if (path.empty()) {
+    return;
+  }
+  std::unique_ptr<CompilationManifest> manifest(new CompilationManifest(
+      path, sys_util::GetEnvInt("XLA_COMPILATION_MANIFEST_SIZE", 256)));
+  std::vector<CompilationManifest::Entry> entries = manifest->GetHottest(
+      sys_util::GetEnvInt("XLA_COMPILATION_MANIFEST_WARMUP", 32));
+
+  // The output shapes are pointed to by the compile instances, so the vector
+  // must never reallocate.
+  std::vector<Shape> output_shapes;
+  output_shapes.reserve(entries.size());
+  std::vector<CompileInstance> instances;
+  for (auto& entry : entries) {
+    // Skip the computations recorded with a different device setup.
+    bool known_devices =
+        std::all_of(entry.devices.begin(), entry.devices.end(),
+                    [this](const string& device) {
+                      return options_.device_map.count(device) > 0;
+                    });
+    xrt::XLAComputation xrt_computation;
+    if (!known_devices ||
+        !xrt_computation.ParseFromString(entry.serialized_computation)) {
+      continue;
+    }
+    output_shapes.emplace_back(
+        xrt_computation.config().program_shape().result());
+    instances.emplace_back(
+        XlaComputation(std::move(*xrt_computation.mutable_hlo_snapshot()
+                                      ->mutable_hlo()
+                                      ->mutable_hlo_module())),
+        std::move(entry.devices), &output_shapes.back());
+  }
+  if (!instances.empty()) {
+    TF_LOG(INFO) << "Compiling " << instances.size()
+                 << " computations from compilation manifest " << path;
+    metrics::TimedSection timed(CompilationWarmUpMetric());
+    Compile(std::move(instances));
+  }
+  // Enabled only after the warm up, which should not count as requests.
+  compilation_manifest_ = std::move(manifest);
+}
+
 void XrtComputationClient::HandleReleaser() {
   auto data_op_generator =
       [this](XrtSession* session, const tensorflow::Scope& scope,
@@ -832,6 +1536,38 @@ const XrtSession::CachedNode& XrtComputationClient::GetExecuteNode(
   return cache->Get();
 }
 
+const XrtSession::CachedNode& XrtComputationClient::GetExecuteReadNode(
+    XrtSession* session, const tensorflow::Scope& scope, const string& device,
+    bool explode_tuple, size_t num_reads) const {
+  string op_name = absl::StrCat("XrtExecuteRead",
+                                explode_tuple ? "Exploded" : "", num_reads);
+  XrtSession::NodeCache* cache =
+      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  if (cache->Empty()) {
+    std::vector<tensorflow::ops::Placeholder> holders(
+        {tensorflow::ops::Placeholder(scope, tensorflow::DT_INT64),
+         tensorflow::ops::Placeholder(scope, tensorflow::DT_STRING),
+         tensorflow::ops::Placeholder(
+             scope, tensorflow::DT_INT64,
+             tensorflow::ops::Placeholder::Shape({-1}))});
+    std::vector<tensorflow::Output> outputs(
+        {tensorflow::ops::XRTExecute(scope, holders[0], holders[1],
+                                     {tensorflow::Output(holders[2])})});
+    for (size_t i = 0; i < num_reads; ++i) {
+      tensorflow::Output handle = outputs.front();
+      if (explode_tuple) {
+        holders.push_back(
+            tensorflow::ops::Placeholder(scope, tensorflow::DT_INT32));
+        handle = tensorflow::ops::Gather(scope, handle, holders.back());
+      }
+      outputs.push_back(tensorflow::ops::XRTReadLiteral(scope, handle));
+    }
+    cache->Add(std::make_shared<XrtSession::CachedNode>(std::move(outputs),
+                                                        std::move(holders)));
+  }
+  return cache->Get();
+}
+
 const XrtSession::CachedNode& XrtComputationClient::GetReadNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const string& device) const {
@@ -863,6 +1599,31 @@ const XrtSession::CachedNode& XrtComputationClient::GetAllocateNode(
   return cache->Get();
 }
 
+const XrtSession::CachedNode& XrtComputationClient::GetTransferNode(
+    XrtSession* session, const tensorflow::Scope& source_scope,
+    const string& source_device, const tensorflow::Scope& scope,
+    const string& device) const {
+  static const string op_name("XrtTransfer");
+  XrtSession::NodeCache* cache = session->GetNodeCache(XrtSession::GetCacheKey(
+      op_name, absl::StrCat(source_device, "->", device)));
+  if (cache->Empty()) {
+    std::vector<tensorflow::ops::Placeholder> holders(
+        {tensorflow::ops::Placeholder(source_scope, tensorflow::DT_INT64),
+         tensorflow::ops::Placeholder(scope, tensorflow::DT_INT64),
+         tensorflow::ops::Placeholder(scope, tensorflow::DT_STRING),
+         tensorflow::ops::Placeholder(
+             scope, tensorflow::DT_INT64,
+             tensorflow::ops::Placeholder::Shape({-1}))});
+    auto literal = tensorflow::ops::XRTReadLiteral(source_scope, holders[0]);
+    auto allocation = tensorflow::ops::XRTExecute(
+        scope, holders[1], holders[2], {tensorflow::Output(holders[3])});
+    cache->Add(std::make_shared<XrtSession::CachedNode>(
+        tensorflow::ops::XRTWriteLiteral(scope, allocation, literal),
+        std::move(holders)));
+  }
+  return cache->Get();
+}
+
 const XrtSession::CachedNode&
 XrtComputationClient::GetReleaseAllocationHandleNode(
     XrtSession* session, const tensorflow::Scope& scope,
@@ -2,11 +2,13 @@
 #define TENSORFLOW_COMPILER_XLA_RPC_XRT_COMPUTATION_CLIENT_H_
 
 #include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 #include "absl/types/optional.h"
@@ -15,6 +17,7 @@
 #include "tensorflow/cc/framework/scope.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/compilation_manifest.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/triggered_task.h"
@@ -27,6 +30,7 @@
 #include "tensorflow/compiler/xrt/cc/ops/xrt_state_ops.h"
 #include "tensorflow/compiler/xrt/xrt.pb.h"
 #include "tensorflow/contrib/tpu/proto/topology.pb.h"
+#include "tensorflow/core/platform/fingerprint.h"
 
 namespace xla {
 
@@ -86,6 +90,16 @@ class XrtComputationClient : public ComputationClient {
     string compilation_device;
   };
 
+  // A compilation in flight. Once completed, done is set, together with either
+  // the computation or the error status of the failed compilation.
+  struct InFlightCompile {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    Status status;
+    std::shared_ptr<Computation> computation;
+  };
+
  public:
   struct Worker {
     Worker(string name, int task_no)
@@ -118,10 +132,25 @@ class XrtComputationClient : public ComputationClient {
   std::vector<std::shared_ptr<Data>> TransferToServer(
       tensorflow::gtl::ArraySlice<const LiteralDevice> literals) override;
 
+  std::vector<std::shared_ptr<Data>> TransferTensorsToServer(
+      tensorflow::gtl::ArraySlice<const TensorSource> tensors) override;
+
+  std::vector<std::vector<std::shared_ptr<Data>>> BroadcastTensorsToServer(
+      tensorflow::gtl::ArraySlice<const TensorSource> tensors,
+      tensorflow::gtl::ArraySlice<const string> devices) override;
+
   std::vector<Literal> TransferFromServer(
       tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles)
       override;
 
+  void TransferTensorsFromServer(
+      tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles,
+      const TensorConsumerFn& consumer_fn) override;
+
+  std::vector<std::shared_ptr<Data>> TransferBetweenDevices(
+      tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles,
+      tensorflow::gtl::ArraySlice<const string> devices) override;
+
   std::vector<std::shared_ptr<Computation>> Compile(
       std::vector<CompileInstance> instances) override;
 
@@ -142,6 +171,14 @@ class XrtComputationClient : public ComputationClient {
       tensorflow::gtl::ArraySlice<const string> devices,
       const ExecuteParallelOptions& options) override;
 
+  std::vector<std::vector<std::shared_ptr<Data>>> ExecuteParallelAndFetch(
+      tensorflow::gtl::ArraySlice<const Computation* const> computations,
+      const std::vector<std::vector<Data*>>& arguments,
+      tensorflow::gtl::ArraySlice<const string> devices,
+      const std::vector<std::vector<int64>>& fetch_indices,
+      std::vector<std::vector<Literal>>* literals,
+      const ExecuteParallelOptions& options) override;
+
   std::vector<std::vector<std::shared_ptr<Data>>> DeconstructTuple(
       tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> tuples) override;
 
@@ -171,26 +208,66 @@ class XrtComputationClient : public ComputationClient {
   string GetCompilationDevice(
       tensorflow::gtl::ArraySlice<const string> devices) const;
 
+  // Returns the compilation cache key of the serialized xrt::XLAComputation,
+  // when compiled for the given devices: a 128-bit fingerprint of both.
+  tensorflow::Fprint128 GetCompilationCacheKey(
+      const string& serialized_computation,
+      tensorflow::gtl::ArraySlice<const string> devices) const;
+
   std::unique_ptr<xrt::XLAComputation> CreateXrtComputation(
       const XlaComputation& computation,
       tensorflow::gtl::ArraySlice<const string> devices,
       const Shape* output_shape) const;
 
+  // Uploads count device allocations, each of which to one or more devices.
+  // The alloc_fn(i, &devices, &shape) calls run in parallel over the XLA thread
+  // pool, and return the scalar DT_STRING tensor holding the i-th serialized
+  // xrt::XLAAllocation, while storing its target devices and shape within the
+  // devices and shape arguments. The size_fn(i) call returns the (estimated)
+  // number of bytes of the i-th allocation, or -1 if unknown, and it is used to
+  // pack the small allocations several per thread pool closure. The returned
+  // result[i][j] is the handle of the i-th allocation on devices[j]. The
+  // serialized allocation is shared by all the device feeds, without being
+  // copied.
+  std::vector<std::vector<std::shared_ptr<Data>>> TransferAllocations(
+      size_t count, const std::function<int64(size_t)>& size_fn,
+      const std::function<tensorflow::Tensor(size_t, std::vector<string>*,
+                                             Shape*)>& alloc_fn);
+
+  // Flattens the TransferAllocations() results of single device allocations.
+  static std::vector<std::shared_ptr<Data>> GetSingleDeviceResults(
+      std::vector<std::vector<std::shared_ptr<Data>>> results);
+
+  // Reads the device data behind the handles, calling read_fn(i, data) with
+  // the serialized LiteralProto fetched for handles[i].
+  void ReadHandles(
+      tensorflow::gtl::ArraySlice<const std::shared_ptr<Data>> handles,
+      const std::function<void(size_t, const string&)>& read_fn);
+
   tensorflow::Tensor GetArgumentsInputs(
       tensorflow::gtl::ArraySlice<Data*> arguments, const string& device,
       tensorflow::ClientSession::FeedType* feed_inputs);
 
+  // Creates the serialized xrt::XRTExecutionConfig for the given options.
+  static string GetExecutionConfig(const ExecuteOptions& options);
+
+  // Marks the handles of the arguments as released, as their ownership is
+  // passed to an execution running with the release_input_handles option.
+  void DonateArguments(tensorflow::gtl::ArraySlice<Data*> arguments);
+
   std::vector<tensorflow::Output> CreateExecuteOps(
       XrtSessionCache::SessionMap* session_map,
       tensorflow::gtl::ArraySlice<const Computation* const> computations,
-      const std::vector<std::vector<Data*>>& arguments, bool explode_tuple,
+      const std::vector<std::vector<Data*>>& arguments,
+      const ExecuteOptions& options,
       tensorflow::gtl::ArraySlice<const string> devices,
       tensorflow::ClientSession::FeedType* feed_inputs);
 
   std::vector<tensorflow::Output> CreateExecuteOps(
       XrtSessionCache::SessionMap* session_map,
       const XrtComputation& computation,
-      const std::vector<std::vector<Data*>>& arguments, bool explode_tuple,
+      const std::vector<std::vector<Data*>>& arguments,
+      const ExecuteOptions& options,
       tensorflow::gtl::ArraySlice<const string> devices,
       tensorflow::ClientSession::FeedType* feed_inputs);
 
@@ -238,6 +315,11 @@ class XrtComputationClient : public ComputationClient {
 
   void InitializeDevices();
 
+  // Loads the compilation manifest, if one is configured via the
+  // XLA_COMPILATION_MANIFEST environment variable, and compiles its hottest
+  // computations.
+  void InitializeCompilationManifest();
+
   std::vector<std::shared_ptr<Data>> GetComputationResults(
       const tensorflow::Tensor& xrt_result, const Shape& result_shape,
       const string& device);
@@ -270,6 +352,29 @@ class XrtComputationClient : public ComputationClient {
                                                const tensorflow::Scope& scope,
                                                const string& device) const;
 
+  // Creates an XRT graph with an XRTExecute operation, whose results are read
+  // back by num_reads XRTReadLiteral operations:
+  //
+  //  outputs[0] = XRTExecute(
+  //    holders[0],
+  //    holders[1],
+  //    holders[2]
+  //  )
+  //  outputs[1 + i] = XRTReadLiteral(
+  //    Gather(outputs[0], holders[3 + i])
+  //  )
+  //
+  // With:
+  //  holders[0] = XLA Computation handle place-holder (DT_INT64)
+  //  holders[1] = xrt::XRTExecutionConfig place-holder (DT_STRING)
+  //  holders[2] = Inputs for the XRTExecute (DT_INT64[])
+  //  holders[3 + i] = Index of the result to be read (DT_INT32)
+  // If explode_tuple is false, the XRTReadLiteral operations read the
+  // XRTExecute result directly, and the index place-holders are missing.
+  const XrtSession::CachedNode& GetExecuteReadNode(
+      XrtSession* session, const tensorflow::Scope& scope,
+      const string& device, bool explode_tuple, size_t num_reads) const;
+
   // Creates an XRT graph with an XRTReadLiteral operation:
   //
   //  XRTReadLiteral(
@@ -294,6 +399,30 @@ class XrtComputationClient : public ComputationClient {
                                                 const tensorflow::Scope& scope,
                                                 const string& device) const;
 
+  // Creates the nodes copying an allocation from source_device to device:
+  //
+  //  XRTWriteLiteral(
+  //    XRTExecute(
+  //      holders[1],
+  //      holders[2],
+  //      holders[3]
+  //    ),
+  //    XRTReadLiteral(holders[0])
+  //  )
+  //
+  // With:
+  //  holders[0] = The source handle place-holder (DT_INT64)
+  //  holders[1] = The handle of the computation creating the destination
+  //               allocation place-holder (DT_INT64)
+  //  holders[2] = xrt::XRTExecutionConfig place-holder (DT_STRING)
+  //  holders[3] = Empty computation inputs place-holder (DT_INT64[])
+  // The XRTReadLiteral node is placed on source_scope, while the others are
+  // placed on scope.
+  const XrtSession::CachedNode& GetTransferNode(
+      XrtSession* session, const tensorflow::Scope& source_scope,
+      const string& source_device, const tensorflow::Scope& scope,
+      const string& device) const;
+
   // Creates an XRTReleaseAllocationHandle node:
   //
   //  XRTReleaseAllocationHandle(
@@ -351,9 +480,17 @@ class XrtComputationClient : public ComputationClient {
   std::map<string, std::vector<int>> device_mesh_coords_;
   XrtSessionCache session_cache_;
   std::unique_ptr<xla_util::TriggeredTask> triggered_task_;
-  util::Cache<string, std::shared_ptr<Computation>,
-              util::PartialHasher<string, 4096>>
+  util::Cache<tensorflow::Fprint128, std::shared_ptr<Computation>,
+              tensorflow::Fprint128Hasher>
       compilation_cache_;
+  // The compilations in flight, which other Compile() calls needing the same
+  // computation wait for, instead of compiling it again.
+  std::mutex compiling_lock_;
+  std::unordered_map<tensorflow::Fprint128, std::shared_ptr<InFlightCompile>,
+                     tensorflow::Fprint128Hasher>
+      compiling_;
+  // Records the compiled computations, if persistent warm-up is enabled.
+  std::unique_ptr<CompilationManifest> compilation_manifest_;
   // Access to the following members must be done while holding lock_.
   // XRT thread safety semantics.
   std::vector<DeviceHandle> released_data_handles_;
@@ -76,6 +76,18 @@ xla::PrimitiveType XlaHelpers::MakeXlaPrimitiveType(
   switch (scalar_type) {
     case at::ScalarType::Float:
       return UseBF16() ? xla::PrimitiveType::BF16 : xla::PrimitiveType::F32;
+    case at::ScalarType::Double:
+      return xla::PrimitiveType::F64;
+    case at::ScalarType::Half:
+      return xla::PrimitiveType::F16;
+    case at::ScalarType::Byte:
+      return xla::PrimitiveType::U8;
+    case at::ScalarType::Char:
+      return xla::PrimitiveType::S8;
+    case at::ScalarType::Short:
+      return xla::PrimitiveType::S16;
+    case at::ScalarType::Int:
+      return xla::PrimitiveType::S32;
     case at::ScalarType::Long:
       return xla::PrimitiveType::S64;
     default:
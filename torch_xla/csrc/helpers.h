@@ -20,24 +20,16 @@ class XlaHelpers {
     return xla::ConstantLiteral(builder, scalar_literal);
   }
 
+  // Creates a XLA constant of the given type for the given scalar_value. The
+  // value goes through a double literal, which can represent the values of
+  // every other type we lower.
   template <class T>
   static xla::XlaOp ScalarValue(T scalar_value, xla::PrimitiveType type,
                                 xla::XlaBuilder* builder) {
-    xla::Literal scalar_literal;
-    switch (type) {
-      case xla::PrimitiveType::F32:
-        scalar_literal = xla::LiteralUtil::CreateR0<float>(scalar_value);
-        break;
-      case xla::PrimitiveType::BF16:
-        scalar_literal = xla::LiteralUtil::CreateR0<tensorflow::bfloat16>(
-            static_cast<tensorflow::bfloat16>(scalar_value));
-        break;
-      case xla::PrimitiveType::S64:
-        scalar_literal = xla::LiteralUtil::CreateR0<xla::int64>(scalar_value);
-        break;
-      default:
-        scalar_literal = xla::LiteralUtil::CreateR0<T>(scalar_value);
-    }
+    xla::Literal scalar_literal =
+        xla::LiteralUtil::CreateR0<double>(static_cast<double>(scalar_value))
+            .Convert(type)
+            .ConsumeValueOrDie();
     return xla::ConstantLiteral(builder, scalar_literal);
   }
 
@@ -5,7 +5,9 @@
 #include "passes/replace_in_place_ops.h"
 #include "passes/replace_untraced_operators.h"
 #include "passes/threshold_backward_peephole.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "torch/csrc/Dtype.h"
 #include "torch/csrc/autograd/utils/wrap_outputs.h"
 #include "torch_util.h"
 #include "translator.h"
@@ -19,6 +21,30 @@ struct NoGilSection {
   PyThreadState* state = nullptr;
 };
 
+// Parses the device casts argument of _xla_create_tensors(), whose entries are
+// either None, or (dtype, scale, offset) tuples.
+std::vector<c10::optional<XLATensor::DeviceCast>> GetDeviceCasts(
+    const std::vector<py::object>& casts) {
+  std::vector<c10::optional<XLATensor::DeviceCast>> device_casts;
+  for (auto& cast : casts) {
+    if (cast.is_none()) {
+      device_casts.emplace_back();
+      continue;
+    }
+    py::tuple cast_tuple = cast.cast<py::tuple>();
+    XLA_CHECK_EQ(cast_tuple.size(), 3);
+    XLA_CHECK(THPDtype_Check(cast_tuple[0].ptr()))
+        << "Expected torch.dtype as device cast type";
+    XLATensor::DeviceCast device_cast;
+    device_cast.type =
+        reinterpret_cast<THPDtype*>(cast_tuple[0].ptr())->scalar_type;
+    device_cast.scale = cast_tuple[1].cast<double>();
+    device_cast.offset = cast_tuple[2].cast<double>();
+    device_casts.push_back(device_cast);
+  }
+  return device_casts;
+}
+
 void InitXlaModuleBindings(py::module m) {
   py::class_<XlaModule, std::shared_ptr<XlaModule>>(m, "XlaModule")
       .def(py::init([](const std::shared_ptr<torch::jit::script::Module> module,
@@ -71,15 +97,48 @@ void InitXlaModuleBindings(py::module m) {
           }
           return result;
         });
+  py::class_<XLATensor::TensorsFetch, std::shared_ptr<XLATensor::TensorsFetch>>(
+      m, "XLATensorsFetch")
+      .def("is_ready",
+           [](const XLATensor::TensorsFetch& fetch) { return fetch.IsReady(); })
+      .def("wait", [](XLATensor::TensorsFetch& fetch) {
+        std::vector<at::Tensor> result;
+        {
+          NoGilSection nogil;
+          result = fetch.Wait();
+        }
+        return result;
+      });
+  m.def("_xla_to_tensors_async",
+        [](const std::vector<std::shared_ptr<XLATensor>>& tensors) {
+          NoGilSection nogil;
+          return XLATensor::GetTensorsAsync(tensors);
+        });
   m.def("_xla_create_tensors",
         [](const std::vector<torch::autograd::Variable>& tensors,
-           const std::vector<std::string>& devices) {
+           const std::vector<std::string>& devices,
+           const std::vector<py::object>& casts) {
+          std::vector<c10::optional<XLATensor::DeviceCast>> device_casts =
+              GetDeviceCasts(casts);
           std::vector<std::shared_ptr<XLATensor>> result;
           {
             NoGilSection nogil;
-            result = XLATensor::CreateTensors(tensors, devices);
+            result = XLATensor::CreateTensors(
+                tensors, devices, casts.empty() ? nullptr : &device_casts);
           }
           return result;
+        },
+        py::arg("tensors"), py::arg("devices"),
+        py::arg("casts") = std::vector<py::object>());
+  m.def("_xla_transfer_tensors",
+        [](const std::vector<std::shared_ptr<XLATensor>>& tensors,
+           const std::vector<std::string>& devices) {
+          std::vector<XLATensor::Device> xla_devices;
+          for (auto& device : devices) {
+            xla_devices.push_back(XLATensor::DeviceFromString(device));
+          }
+          NoGilSection nogil;
+          return XLATensor::TransferTensors(tensors, xla_devices);
         });
   m.def("_xla_counter_value", [](const std::string& name) -> py::object {
     xla::metrics::CounterData* data = xla::metrics::GetCounter(name);
@@ -1,11 +1,25 @@
 #include "ir.h"
 
+#include <mutex>
 #include <sstream>
 
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/core/lib/hash/hash.h"
 
 namespace torch_xla {
 namespace ir {
+namespace {
+
+// Nodes can be released by threads other than the one building new graphs on
+// top of their operands (like when the tensors of an asynchronous apply go
+// away), so the updates of the operands uses need to be serialized.
+std::mutex* GetUsesMutex() {
+  static std::mutex* uses_mutex = new std::mutex();
+  return uses_mutex;
+}
+
+}  // namespace
 
 bool Use::operator<(const Use& rhs) const {
   int cmp = node->op().compare(rhs.node->op());
@@ -15,7 +29,12 @@ bool Use::operator<(const Use& rhs) const {
   if (operand_index != rhs.operand_index) {
     return operand_index < rhs.operand_index;
   }
-  return index < rhs.index;
+  if (index != rhs.index) {
+    return index < rhs.index;
+  }
+  // Different nodes of the same kind can use the same output at the same
+  // operand position, and they must not collapse into a single use.
+  return node < rhs.node;
 }
 
 std::string Use::ToString() const {
@@ -32,14 +51,23 @@ std::string Output::ToString() const {
 
 Node::Node(std::string op,
            tensorflow::gtl::ArraySlice<const NodeOperand> operands,
-           size_t num_outputs)
-    : op_(std::move(op)), num_outputs_(num_outputs) {
+           xla::Shape shape, size_t num_outputs, size_t hash_seed)
+    : op_(std::move(op)), num_outputs_(num_outputs), shape_(std::move(shape)) {
+  hash_ = tensorflow::Hash64Combine(tensorflow::Hash64(op_), hash_seed);
+  hash_ = tensorflow::Hash64Combine(hash_, xla::ShapeUtil::Hash(shape_));
   for (auto& operand : operands) {
     AddOperand(operand.node, operand.index);
+    graph_size_ += operand.node->graph_size();
+    graph_cost_ += operand.node->graph_cost();
+    graph_data_bytes_ += operand.node->graph_data_bytes();
+    hash_ = tensorflow::Hash64Combine(hash_, operand.node->hash());
+    hash_ = tensorflow::Hash64Combine(hash_, operand.index);
   }
+  graph_cost_ += cost();
 }
 
 Node::~Node() {
+  std::lock_guard<std::mutex> lock(*GetUsesMutex());
   for (size_t i = 0; i < operands_as_outputs_.size(); ++i) {
     operands_as_outputs_[i].node->RemoveUse(
         Use(this, i, operands_as_outputs_[i].index));
@@ -50,30 +78,81 @@ void Node::AddOperand(NodePtr node, size_t index) {
   XLA_CHECK_LT(index, node->num_outputs());
   operands_.push_back(std::move(node));
   operands_as_outputs_.push_back(Output(operands_.back().get(), index));
+  std::lock_guard<std::mutex> lock(*GetUsesMutex());
   operands_.back()->AddUse(Use(this, operands_.size() - 1, index));
 }
 
 void Node::ReplaceOperand(size_t operand_no, NodePtr node, size_t index) {
   XLA_CHECK_LT(index, node->num_outputs());
+  // The replaced operand is released outside of the lock, as its destructor
+  // might need to acquire it.
+  NodePtr replaced_operand;
+  std::lock_guard<std::mutex> lock(*GetUsesMutex());
   Output* output = &operands_as_outputs_.at(operand_no);
   output->node->RemoveUse(Use(this, operand_no, output->index));
   node->AddUse(Use(this, operand_no, index));
   *output = Output(node.get(), index);
+  replaced_operand = std::move(operands_[operand_no]);
   operands_[operand_no] = std::move(node);
 }
 
 void Node::ReplaceAllUsesWith(NodePtr node, size_t index) {
   // A call to ReplaceOperand() will end up calling RemoveUse() into the
   // current node, so snapshot the current uses and iterate over them.
-  std::vector<Use> current_uses(uses_.begin(), uses_.end());
+  std::vector<Use> current_uses;
+  {
+    std::lock_guard<std::mutex> lock(*GetUsesMutex());
+    current_uses.assign(uses_.begin(), uses_.end());
+  }
   for (auto& use : current_uses) {
     use.node->ReplaceOperand(use.operand_index, node, index);
   }
 }
 
+void Node::RefreshGraphStats() const {
+  std::unordered_set<const Node*> visited;
+  std::vector<const Node*> queue({this});
+  visited.insert(this);
+  xla::int64 graph_cost = 0;
+  xla::int64 graph_data_bytes = 0;
+  while (!queue.empty()) {
+    const Node* node = queue.back();
+    queue.pop_back();
+    graph_cost += node->cost();
+    graph_data_bytes += node->data_bytes_;
+    for (auto& operand : node->operands()) {
+      if (visited.insert(operand.node).second) {
+        queue.push_back(operand.node);
+      }
+    }
+  }
+  graph_size_ = visited.size();
+  graph_cost_ = graph_cost;
+  graph_data_bytes_ = graph_data_bytes;
+}
+
+void Node::SetDataBytes(xla::int64 data_bytes) {
+  XLA_CHECK(operands_.empty()) << *this;
+  data_bytes_ = data_bytes;
+  graph_data_bytes_ = data_bytes;
+}
+
+xla::int64 Node::cost() const {
+  xla::int64 cost = 0;
+  if (!operands_.empty()) {
+    xla::ShapeUtil::ForEachSubshape(
+        shape_, [&](const xla::Shape& subshape, const xla::ShapeIndex&) {
+          if (xla::ShapeUtil::IsArray(subshape)) {
+            cost += xla::ShapeUtil::ElementsIn(subshape);
+          }
+        });
+  }
+  return cost;
+}
+
 std::string Node::ToString() const {
   std::stringstream ss;
-  ss << op();
+  ss << op() << ", shape=" << xla::ShapeUtil::HumanString(shape());
   if (num_outputs() > 1) {
     ss << ";n=" << num_outputs();
   }
@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 
@@ -106,9 +107,12 @@ class Node {
   // Creates a new node with the given op name. The op name is a unique
   // identifier for the operation, which in the PyTorch case will be the full
   // operation signature which is currently used throughout the code base.
-  // The num_outputs tells how many outputs a given operation generates.
+  // The shape is the one of the value produced by the node (a tuple shape if
+  // the node has multiple outputs), and num_outputs tells how many outputs a
+  // given operation generates. The hash_seed must capture the node attributes
+  // which affect the lowering, and which are not visible from the operands.
   Node(std::string op, tensorflow::gtl::ArraySlice<const NodeOperand> operands,
-       size_t num_outputs = 1);
+       xla::Shape shape, size_t num_outputs = 1, size_t hash_seed = 0);
 
   virtual ~Node();
 
@@ -116,8 +120,39 @@ class Node {
 
   size_t num_outputs() const { return num_outputs_; }
 
+  const xla::Shape& shape() const { return shape_; }
+
   const std::vector<Output>& operands() const { return operands_as_outputs_; }
 
+  const Output& operand(size_t i) const { return operands_as_outputs_.at(i); }
+
+  // The structural hash of the graph rooted at this node. It captures the
+  // operations, their attributes, shapes and the graph topology, but not the
+  // identity of the device data feeding the graph. The hash is computed at
+  // construction time, so it does not reflect later ReplaceOperand() calls.
+  size_t hash() const { return hash_; }
+
+  // Returns an upper bound of the number of nodes within the graph rooted at
+  // this node. The value is computed incrementally by summing the operands
+  // sizes, so nodes reachable through multiple paths are counted more than
+  // once.
+  xla::int64 graph_size() const { return graph_size_; }
+
+  // Returns an upper bound, computed like the graph_size() one, of the
+  // estimated cost of the graph rooted at this node. Every node which has
+  // operands costs as many units as the elements it produces.
+  xla::int64 graph_cost() const { return graph_cost_; }
+
+  // Returns an upper bound, computed like the graph_size() one, of the bytes
+  // of device data which the graph rooted at this node keeps alive.
+  xla::int64 graph_data_bytes() const { return graph_data_bytes_; }
+
+  // Computes the exact values of graph_size(), graph_cost() and
+  // graph_data_bytes(), by visiting the unique nodes within the graph rooted at
+  // this node, and stores them, so that the nodes which will be built on top of
+  // this one start from tighter bounds.
+  void RefreshGraphStats() const;
+
   const std::set<Use>& uses() const { return uses_; }
 
   void ReplaceOperand(size_t operand_no, NodePtr node, size_t index = 0);
@@ -128,7 +163,14 @@ class Node {
 
   virtual XlaOpVector Lower(LoweringContext* loctx) const;
 
+ protected:
+  // Sets the bytes of device data held by this node. Must be called only by
+  // the constructors of the nodes without operands.
+  void SetDataBytes(xla::int64 data_bytes);
+
  private:
+  xla::int64 cost() const;
+
   // Adds node's index output number as operand.
   void AddOperand(NodePtr node, size_t index = 0);
 
@@ -139,6 +181,12 @@ class Node {
   // The name/ID of the operation captured by this node.
   const std::string op_;
   const size_t num_outputs_ = 1;
+  xla::Shape shape_;
+  size_t hash_ = 0;
+  xla::int64 data_bytes_ = 0;
+  mutable xla::int64 graph_size_ = 1;
+  mutable xla::int64 graph_cost_ = 0;
+  mutable xla::int64 graph_data_bytes_ = 0;
   // A node holds a real reference to its operands.
   std::vector<NodePtr> operands_;
   // Outputs do not hold references on the nodes, and neither do the uses, since
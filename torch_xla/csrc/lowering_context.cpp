@@ -1,6 +1,12 @@
 #include "lowering_context.h"
 
+#include <unordered_map>
+
+#include "absl/strings/str_cat.h"
+#include "ops/device_data.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/fingerprint.h"
 
 namespace torch_xla {
 namespace ir {
@@ -50,12 +56,98 @@ void LoweringContext::AssignOutputOp(const Output& output, xla::XlaOp op) {
   emitted_outputs_[output] = op;
 }
 
-xla::XlaOp LoweringContext::GetOutputOp(const Output& output) const {
+xla::XlaOp LoweringContext::GetOutputOp(const Output& output) {
   auto it = emitted_outputs_.find(output);
-  XLA_CHECK(it != emitted_outputs_.end())
-      << "No XLA operation amitted for output: " << output;
+  if (it == emitted_outputs_.end()) {
+    // Iterative post-order visit, with the operands visited in ordinal order,
+    // so that deep graphs do not exhaust the stack, and the device data gets
+    // assigned to parameters in depth-first discovery order.
+    std::vector<std::pair<Node*, bool>> queue({{output.node, false}});
+    while (!queue.empty()) {
+      Node* node = queue.back().first;
+      if (emitted_outputs_.count(Output(node)) > 0) {
+        queue.pop_back();
+      } else if (queue.back().second) {
+        queue.pop_back();
+        LowerNode(node);
+      } else {
+        queue.back().second = true;
+        const std::vector<Output>& operands = node->operands();
+        for (auto rit = operands.rbegin(); rit != operands.rend(); ++rit) {
+          if (emitted_outputs_.count(*rit) == 0) {
+            queue.emplace_back(rit->node, false);
+          }
+        }
+      }
+    }
+    it = emitted_outputs_.find(output);
+    XLA_CHECK(it != emitted_outputs_.end())
+        << "No XLA operation emitted for output: " << output;
+  }
   return it->second;
 }
 
+void LoweringContext::LowerNode(Node* node) {
+  XlaOpVector ops = node->Lower(this);
+  XLA_CHECK_EQ(ops.size(), node->num_outputs()) << *node;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    AssignOutputOp(Output(node, i), ops[i]);
+  }
+}
+
+GraphFingerprint ComputeGraphFingerprint(
+    tensorflow::gtl::ArraySlice<const Node* const> roots) {
+  // Visit the graphs in the same depth-first, operands ordinal order used by
+  // the LoweringContext, so that the device data gets assigned the same
+  // parameter positions it would get when lowering.
+  // The sequence hash uses the fingerprint functions, rather than the hash
+  // ones, and captures the nodes which are visited again by their visit
+  // index.
+  GraphFingerprint fingerprint;
+  std::unordered_map<xla::ComputationClient::Data*, size_t> data_slots;
+  std::unordered_map<const Node*, size_t> visited;
+  std::vector<const Node*> queue;
+  for (auto root : roots) {
+    fingerprint.hash =
+        tensorflow::Hash64Combine(fingerprint.hash, root->hash());
+    queue.push_back(root);
+    while (!queue.empty()) {
+      const Node* node = queue.back();
+      queue.pop_back();
+      auto visit = visited.emplace(node, visited.size());
+      if (!visit.second) {
+        fingerprint.sequence_hash = tensorflow::FingerprintCat64(
+            fingerprint.sequence_hash, visit.first->second);
+        continue;
+      }
+      fingerprint.sequence_hash = tensorflow::FingerprintCat64(
+          fingerprint.sequence_hash, tensorflow::Fingerprint64(node->op()));
+      fingerprint.sequence_hash =
+          tensorflow::FingerprintCat64(fingerprint.sequence_hash, node->hash());
+      const ops::DeviceData* device_data =
+          dynamic_cast<const ops::DeviceData*>(node);
+      if (device_data != nullptr) {
+        xla::ComputationClient::Data* data = device_data->data().get();
+        auto it =
+            data_slots.emplace(data, fingerprint.parameters_data.size()).first;
+        if (it->second == fingerprint.parameters_data.size()) {
+          fingerprint.parameters_data.push_back(data);
+          fingerprint.parameters_uses.push_back(0);
+        }
+        fingerprint.parameters_uses[it->second] += 1;
+        fingerprint.hash =
+            tensorflow::Hash64Combine(fingerprint.hash, it->second);
+      }
+      const std::vector<Output>& operands = node->operands();
+      for (auto rit = operands.rbegin(); rit != operands.rend(); ++rit) {
+        fingerprint.sequence_hash = tensorflow::FingerprintCat64(
+            fingerprint.sequence_hash, rit->index);
+        queue.push_back(rit->node);
+      }
+    }
+  }
+  return fingerprint;
+}
+
 }  // namespace ir
 }  // namespace torch_xla
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -9,12 +10,15 @@
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
 
 namespace torch_xla {
 namespace ir {
 
 class LoweringContext {
  public:
+  explicit LoweringContext(const std::string& name) : builder_(name) {}
+
   xla::XlaBuilder* builder() { return &builder_; }
 
   // If a parameter associated with data has already been declared, it will be
@@ -35,8 +39,12 @@ class LoweringContext {
   // operands among the emitted outputs.
   void AssignOutputOp(const Output& output, xla::XlaOp op);
 
-  // Retrieves the lowered operation for a output.
-  xla::XlaOp GetOutputOp(const Output& output) const;
+  // Retrieves the lowered operation for a output. If the output has not been
+  // emitted yet, the graph it depends on gets lowered first, with the operands
+  // of every node being lowered before the node itself. Each node is lowered
+  // only once within a context, so nodes shared by many consumers will be
+  // emitted a single time.
+  xla::XlaOp GetOutputOp(const Output& output);
 
   // Build the XLA computation capturing all the operations created with the
   // embedded XLA builder (returned by the builder() API).
@@ -49,6 +57,10 @@ class LoweringContext {
   xla::StatusOr<xla::XlaComputation> Build(const xla::XlaOp& root);
 
  private:
+  // Lowers a single node, whose operands must have already been emitted, and
+  // assigns the resulting XLA operations to the node outputs.
+  void LowerNode(Node* node);
+
   xla::XlaBuilder builder_;
   std::vector<std::shared_ptr<xla::ComputationClient::Data>> parameters_;
   std::unordered_map<xla::ComputationClient::Data*, xla::XlaOp> parameters_map_;
@@ -56,5 +68,26 @@ class LoweringContext {
   OutputMap<xla::XlaOp> emitted_outputs_;
 };
 
+// The fingerprint of a set of graphs which are going to be lowered together
+// within the same LoweringContext.
+struct GraphFingerprint {
+  // Combines the structural hashes of the root nodes, with the positions the
+  // device data would take within the computation parameters. Graphs with the
+  // same hash lower to the same XLA computation.
+  size_t hash = 0;
+  // An independent hash of the operations and their operands, in traversal
+  // order, which together with hash makes a 128 bit key for the graphs.
+  xla::uint64 sequence_hash = 0;
+  // The unique device data feeding the graphs, in traversal order.
+  std::vector<xla::ComputationClient::Data*> parameters_data;
+  // The number of device data nodes referencing each of the parameters_data.
+  std::vector<size_t> parameters_uses;
+};
+
+// Computes the fingerprint of the graphs rooted at roots, without lowering
+// them. The cost is linear in the number of unique graph nodes.
+GraphFingerprint ComputeGraphFingerprint(
+    tensorflow::gtl::ArraySlice<const Node* const> roots);
+
 }  // namespace ir
 }  // namespace torch_xla
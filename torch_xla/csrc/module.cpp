@@ -11,7 +11,12 @@
 #include "passes/replace_in_place_ops.h"
 #include "passes/replace_untraced_operators.h"
 #include "passes/threshold_backward_peephole.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "torch/csrc/jit/passes/canonicalize_ops.h"
 #include "torch/csrc/jit/passes/common_subexpression_elimination.h"
@@ -73,6 +78,8 @@ XlaModule::XlaModule(const std::shared_ptr<torch::jit::script::Module> module,
       differentiate_(differentiate),
       script_module_(module) {}
 
+XlaModule::~XlaModule() { XLATensor::WaitForAsyncApply(); }
+
 void XlaModule::Initialize(const TensorBatchVector& inputs) {
   if (script_module_ == nullptr) {
     return;
@@ -89,16 +96,19 @@ void XlaModule::Initialize(const TensorBatchVector& inputs) {
   std::vector<bool> param_requires_grad;
   GatherParameters(&params_buffers_regather, &param_requires_grad,
                    *script_module_);
-  // The loop below is going to send individual parameters to the different
-  // cores. We might need to do something smarter here.
+  // Every parameter is converted only once, and broadcast to all the replica
+  // devices.
   devices_ = CommonDevicesForReplicas(inputs);
-  for (const auto& device : devices_) {
+  std::vector<torch::autograd::Variable> params_variables;
+  for (auto param : params_buffers_regather) {
+    params_variables.push_back(torch::autograd::as_variable_ref(*param));
+  }
+  auto params_tensors = XLATensor::BroadcastTensors(params_variables, devices_);
+  for (size_t i = 0; i < devices_.size(); ++i) {
     TensorBatchVector::value_type replica_params;
     TensorBatchVector::value_type optimizable_replica_params;
-    for (size_t j = 0; j < params_buffers_regather.size(); ++j) {
-      replica_params.push_back(XLATensor::Create(
-          torch::autograd::as_variable_ref(*params_buffers_regather[j]),
-          device));
+    for (size_t j = 0; j < params_tensors.size(); ++j) {
+      replica_params.push_back(params_tensors[j][i]);
       if (param_requires_grad[j]) {
         optimizable_replica_params.push_back(replica_params.back());
       }
@@ -271,16 +281,10 @@ void XlaModule::backward(const TensorBatchVector& grad_outputs) {
           replica_raw_grad_outputs[j]->shape(), kind));
     }
 
-    XlaTranslator xla_bwd_impl(gradient_.df, GetPrecisionConfig());
-    xla::XlaComputation computation =
-        xla_bwd_impl
-            .BuildComputation("XlaBackward", backward_shapes,
-                              backward_size_op_values_,
-                              GetBackwardBuildOptions(inputs_.size()))
-            .computation;
-    xla::Shape result_shape = GetResultShape(computation, grad_outputs);
-    backward_computation_ = XlaGetClient()->Compile(
-        std::move(computation), GetStringDevices(), &result_shape);
+    backward_computation_ = TakeSpeculativeBackward(&backward_shapes);
+    if (backward_computation_ == nullptr) {
+      backward_computation_ = CompileBackward(backward_shapes, grad_outputs);
+    }
   }
   // Collect the computation client data vector.
   DataBatchVector raw_grad_outputs_data =
@@ -333,6 +337,9 @@ XlaModule::TensorBatchVector XlaModule::RunFusedTrain(
   DataBatchVector inputs_params_buffers_data =
       GetDataBatchVector(inputs_params_buffers, /*zero_input=*/nullptr);
   if (forward_computation_ == nullptr) {
+    // The fused computation replaces the backward one, and translating it must
+    // not race with a background translation of the backward graph.
+    TakeSpeculativeBackward(/*backward_shapes=*/nullptr);
     // Shapes are going to be the same for all replicas, so use the ones of the
     // first replica here.
     const TensorBatchVector::value_type& replica_inputs =
@@ -502,6 +509,9 @@ XlaModule::TensorBatchVector XlaModule::RunUnfusedForward(
     forward_computation_ = XlaGetClient()->Compile(
         std::move(forward_translation_result.computation), GetStringDevices(),
         &result_shape);
+    if (differentiate_) {
+      SpeculateBackwardCompile(inputs_params_buffers, result_shape);
+    }
   }
 
   TensorBatchVector raw_outputs =
@@ -604,12 +614,115 @@ XlaTranslator::BuildOptions XlaModule::GetBackwardBuildOptions(
   return options;
 }
 
+std::shared_ptr<xla::ComputationClient::Computation>
+XlaModule::CompileBackward(
+    const std::vector<XlaTranslator::ParameterShape>& backward_shapes,
+    const TensorBatchVector& device_tensors) {
+  XlaTranslator xla_bwd_impl(gradient_.df, GetPrecisionConfig());
+  xla::XlaComputation computation =
+      xla_bwd_impl
+          .BuildComputation("XlaBackward", backward_shapes,
+                            backward_size_op_values_,
+                            GetBackwardBuildOptions(devices_.size()))
+          .computation;
+  xla::Shape result_shape = GetResultShape(computation, device_tensors);
+  return XlaGetClient()->Compile(std::move(computation), GetStringDevices(),
+                                 &result_shape);
+}
+
+void XlaModule::SpeculateBackwardCompile(
+    const TensorBatchVector& inputs_params_buffers,
+    const xla::Shape& forward_result_shape) {
+  static const bool speculative_compile =
+      xla::sys_util::GetEnvInt("XLA_SPECULATIVE_COMPILE", 1) != 0;
+  if (!speculative_compile ||
+      !xla::ShapeUtil::IsTuple(forward_result_shape)) {
+    return;
+  }
+  // Mirrors the parameters collected by backward(): the gradients of the real
+  // outputs (which have the same shapes of the outputs), the zeroed captured
+  // outputs, and the captured inputs and outputs. A wrong guess only costs a
+  // wasted compilation, as backward() checks the shapes before using it.
+  auto output_shape = [&](size_t index) -> const xla::Shape& {
+    return xla::ShapeUtil::GetTupleElementShape(forward_result_shape, index);
+  };
+  auto speculation = std::make_shared<SpeculativeCompile>();
+  const auto input_vjps_real_outputs = InputVjpsRealOutputCount(gradient_);
+  for (size_t i = 0; i < gradient_.df_input_vjps.size(); ++i) {
+    const auto raw_output_index = gradient_.df_input_vjps[i];
+    if (i < input_vjps_real_outputs) {
+      speculation->parameter_shapes.emplace_back(
+          output_shape(raw_output_index),
+          XlaTranslator::ParameterKind::kGraphInput);
+    } else {
+      speculation->parameter_shapes.emplace_back(
+          output_shape(gradient_.f_real_outputs + raw_output_index -
+                       input_vjps_real_outputs),
+          XlaTranslator::ParameterKind::kZeroInput);
+    }
+  }
+  for (auto j : gradient_.df_input_captured_inputs) {
+    speculation->parameter_shapes.emplace_back(
+        inputs_params_buffers.front().at(j)->shape(),
+        XlaTranslator::ParameterKind::kGraphInput);
+  }
+  for (auto j : gradient_.df_input_captured_outputs) {
+    speculation->parameter_shapes.emplace_back(
+        output_shape(j), XlaTranslator::ParameterKind::kGraphInput);
+  }
+
+  XLA_COUNTER("SpeculativeBackwardCompile", 1);
+  auto module = shared_from_this();
+  auto compile_fn = [module, speculation, inputs_params_buffers]() {
+    speculation->computation = module->CompileBackward(
+        speculation->parameter_shapes, inputs_params_buffers);
+  };
+  backward_speculation_ = speculation;
+  xla::xla_env::ScheduleIoClosure(
+      speculation->mwait.Completer(std::move(compile_fn)));
+}
+
+std::shared_ptr<xla::ComputationClient::Computation>
+XlaModule::TakeSpeculativeBackward(
+    const std::vector<XlaTranslator::ParameterShape>* backward_shapes) {
+  std::shared_ptr<SpeculativeCompile> speculation =
+      std::move(backward_speculation_);
+  if (speculation == nullptr) {
+    return nullptr;
+  }
+  xla::Status status = speculation->mwait.Wait();
+  if (!status.ok()) {
+    TF_VLOG(1) << "Speculative backward compilation failed: " << status;
+    return nullptr;
+  }
+  if (backward_shapes == nullptr) {
+    return nullptr;
+  }
+  auto same_shape = [](const XlaTranslator::ParameterShape& shape1,
+                       const XlaTranslator::ParameterShape& shape2) {
+    return shape1.kind == shape2.kind &&
+           xla::ShapeUtil::Equal(shape1.shape, shape2.shape);
+  };
+  if (!std::equal(backward_shapes->begin(), backward_shapes->end(),
+                  speculation->parameter_shapes.begin(),
+                  speculation->parameter_shapes.end(), same_shape)) {
+    XLA_COUNTER("SpeculativeBackwardCompileMiss", 1);
+    return nullptr;
+  }
+  XLA_COUNTER("SpeculativeBackwardCompileHit", 1);
+  return speculation->computation;
+}
+
 void XlaModule::FlushTensorsOperations() {
   // We might have to do something smarter here, as we are syncing even tensors
   // which are not part of the traning loop. Nothing happens, but if we want to
   // fuse the sync operation with the forward+backward+optimizer, we need to
   // have a path leading to the same XLA computation.
-  std::vector<std::shared_ptr<XLATensor>> tensors = XLATensor::GetLiveTensors();
+  // Only the tensors with pending graphs are passed, as the device data read
+  // by the pending graphs is mapped back to the unique ID of the tensors owning
+  // it through the tensors arena index.
+  std::vector<std::shared_ptr<XLATensor>> tensors =
+      XLATensor::GetPendingTensors(/*device=*/nullptr);
   XLATensor::ApplyPendingGraph(tensors, &apply_context_);
 }
 
@@ -3,6 +3,7 @@
 #include <initializer_list>
 
 #include "tensor.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "torch/csrc/autograd/variable.h"
 #include "torch/csrc/jit/script/module.h"
 #include "torch/csrc/utils/disallow_copy.h"
@@ -28,6 +29,10 @@ struct XlaModule : public std::enable_shared_from_this<XlaModule> {
   XlaModule(const std::shared_ptr<torch::jit::script::Module> module,
             bool use_full_conv_precision, bool differentiate);
 
+  // Waits for the asynchronous apply operations which might be using the
+  // module apply context.
+  ~XlaModule();
+
   TensorBatchVector forward(const TensorBatchVector& inputs);
   // For the given gradient outputs, compute the gradient of input and
   // parameters and set it as their grad field.
@@ -93,6 +98,24 @@ struct XlaModule : public std::enable_shared_from_this<XlaModule> {
   // Creates the build options to be used to create a backward pass computation.
   XlaTranslator::BuildOptions GetBackwardBuildOptions(size_t num_replicas);
 
+  // Builds and compiles the backward computation for the given parameter
+  // shapes. The device_tensors are only used to select the result layout.
+  std::shared_ptr<xla::ComputationClient::Computation> CompileBackward(
+      const std::vector<XlaTranslator::ParameterShape>& backward_shapes,
+      const TensorBatchVector& device_tensors);
+
+  // Starts compiling the backward computation in background, predicting its
+  // parameter shapes from the forward ones, so that the compilation overlaps
+  // with the forward execution.
+  void SpeculateBackwardCompile(const TensorBatchVector& inputs_params_buffers,
+                                const xla::Shape& forward_result_shape);
+
+  // Waits for the background compilation started by
+  // SpeculateBackwardCompile(), if any, and returns its result if it was
+  // compiled for backward_shapes. Returns nullptr otherwise.
+  std::shared_ptr<xla::ComputationClient::Computation> TakeSpeculativeBackward(
+      const std::vector<XlaTranslator::ParameterShape>* backward_shapes);
+
   // Makes sure the XLA tensors partecipating to the forward/backward
   // computation have their accumulated operations sync to device memory.
   void FlushTensorsOperations();
@@ -151,6 +174,15 @@ struct XlaModule : public std::enable_shared_from_this<XlaModule> {
 
   std::shared_ptr<xla::ComputationClient::Computation> forward_computation_;
   std::shared_ptr<xla::ComputationClient::Computation> backward_computation_;
+  // The backward computation being compiled in background, if any.
+  struct SpeculativeCompile {
+    SpeculativeCompile() : mwait(1) {}
+
+    std::vector<XlaTranslator::ParameterShape> parameter_shapes;
+    std::shared_ptr<xla::ComputationClient::Computation> computation;
+    xla::xla_util::MultiWait mwait;
+  };
+  std::shared_ptr<SpeculativeCompile> backward_speculation_;
   XlaComputationInOut::SizeOpValues backward_size_op_values_;
 
   // Information needed to connect the forward and backward graphs.
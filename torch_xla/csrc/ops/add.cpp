@@ -0,0 +1,24 @@
+#include "ops/add.h"
+
+#include "helpers.h"
+#include "lowering_context.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+Add::Add(const NodePtr& input, const NodePtr& other, const NodePtr& alpha)
+    : Node("aten::add",
+           {NodeOperand(input), NodeOperand(other), NodeOperand(alpha)},
+           XlaHelpers::GetPromotedShape(input->shape(), other->shape())) {}
+
+XlaOpVector Add::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input_op = loctx->GetOutputOp(operand(0));
+  xla::XlaOp other_op = loctx->GetOutputOp(operand(1));
+  xla::XlaOp alpha_op = loctx->GetOutputOp(operand(2));
+  return {XlaHelpers::PromotedAdd(input_op, other_op * alpha_op)};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
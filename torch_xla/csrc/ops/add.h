@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Computes input + other * alpha, with the operands shapes and types promoted
+// to a common one. The alpha operand is a scalar node.
+class Add : public Node {
+ public:
+  Add(const NodePtr& input, const NodePtr& other, const NodePtr& alpha);
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Computes input + (tensor1 / tensor2) * value, with the operands shapes and
+// types promoted to a common one. The value operand is a scalar node.
+class Addcdiv : public Node {
+ public:
+  Addcdiv(const NodePtr& input, const NodePtr& tensor1, const NodePtr& tensor2,
+          const NodePtr& value);
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,38 @@
+#include "ops/addcmul.h"
+
+#include "helpers.h"
+#include "lowering_context.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const NodePtr& input, const NodePtr& tensor1,
+                           const NodePtr& tensor2) {
+  return XlaHelpers::GetPromotedShape(
+      input->shape(),
+      XlaHelpers::GetPromotedShape(tensor1->shape(), tensor2->shape()));
+}
+
+}  // namespace
+
+Addcmul::Addcmul(const NodePtr& input, const NodePtr& tensor1,
+                 const NodePtr& tensor2, const NodePtr& value)
+    : Node("aten::addcmul",
+           {NodeOperand(input), NodeOperand(tensor1), NodeOperand(tensor2),
+            NodeOperand(value)},
+           NodeOutputShape(input, tensor1, tensor2)) {}
+
+XlaOpVector Addcmul::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input_op = loctx->GetOutputOp(operand(0));
+  xla::XlaOp tensor1_op = loctx->GetOutputOp(operand(1));
+  xla::XlaOp tensor2_op = loctx->GetOutputOp(operand(2));
+  xla::XlaOp value_op = loctx->GetOutputOp(operand(3));
+  xla::XlaOp mul_op = XlaHelpers::PromotedMul(tensor1_op, tensor2_op);
+  return {XlaHelpers::PromotedAdd(input_op, mul_op * value_op)};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
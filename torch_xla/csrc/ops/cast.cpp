@@ -0,0 +1,39 @@
+#include "ops/cast.h"
+
+#include <sstream>
+
+#include "lowering_context.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape CastShape(const xla::Shape& shape, xla::PrimitiveType type) {
+  xla::Shape cast_shape(shape);
+  cast_shape.set_element_type(type);
+  return cast_shape;
+}
+
+}  // namespace
+
+Cast::Cast(const NodePtr& input, xla::PrimitiveType type)
+    : Node("xla::cast", {NodeOperand(input)}, CastShape(input->shape(), type)),
+      type_(type) {}
+
+std::string Cast::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString()
+     << ", type=" << xla::primitive_util::LowercasePrimitiveTypeName(type_);
+  return ss.str();
+}
+
+XlaOpVector Cast::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input_op = loctx->GetOutputOp(operand(0));
+  return {xla::ConvertElementType(input_op, type_)};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
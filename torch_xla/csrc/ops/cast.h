@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+#include "ir.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Converts the operand elements to the given type. The target type is part of
+// the node shape, and hence of its hash.
+class Cast : public Node {
+ public:
+  Cast(const NodePtr& input, xla::PrimitiveType type);
+
+  std::string ToString() const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  xla::PrimitiveType type() const { return type_; }
+
+ private:
+  xla::PrimitiveType type_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
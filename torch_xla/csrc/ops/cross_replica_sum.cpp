@@ -0,0 +1,58 @@
+#include "ops/cross_replica_sum.h"
+
+#include <sstream>
+
+#include "absl/strings/str_join.h"
+#include "lowering_context.h"
+#include "tensorflow/core/lib/hash/hash.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+size_t GroupsHash(const std::vector<std::vector<xla::int64>>& groups) {
+  size_t hash = 0;
+  for (auto& group : groups) {
+    hash = tensorflow::Hash64Combine(hash, group.size());
+    for (auto replica_id : group) {
+      hash = tensorflow::Hash64Combine(hash, replica_id);
+    }
+  }
+  return hash;
+}
+
+}  // namespace
+
+CrossReplicaSum::CrossReplicaSum(const NodePtr& input,
+                                 std::vector<std::vector<xla::int64>> groups)
+    : Node("xla::cross_replica_sum", {NodeOperand(input)}, input->shape(),
+           /*num_outputs=*/1, GroupsHash(groups)),
+      groups_(std::move(groups)) {}
+
+std::string CrossReplicaSum::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ", (") << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+XlaOpVector CrossReplicaSum::Lower(LoweringContext* loctx) const {
+  std::vector<xla::ReplicaGroup> crs_groups;
+  for (auto& group : groups_) {
+    xla::ReplicaGroup rgroup;
+    for (auto replica_id : group) {
+      rgroup.add_replica_ids(replica_id);
+    }
+    crs_groups.push_back(std::move(rgroup));
+  }
+  xla::XlaOp input_op = loctx->GetOutputOp(operand(0));
+  return {xla::CrossReplicaSum(input_op, crs_groups)};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
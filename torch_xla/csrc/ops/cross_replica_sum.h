@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Sums the input across the replicas within each of the groups.
+class CrossReplicaSum : public Node {
+ public:
+  CrossReplicaSum(const NodePtr& input,
+                  std::vector<std::vector<xla::int64>> groups);
+
+  std::string ToString() const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  const std::vector<std::vector<xla::int64>>& groups() const {
+    return groups_;
+  }
+
+ private:
+  std::vector<std::vector<xla::int64>> groups_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,29 @@
+#include "ops/device_data.h"
+
+#include <sstream>
+
+#include "lowering_context.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+DeviceData::DeviceData(std::shared_ptr<xla::ComputationClient::Data> data)
+    : Node("xla::device_data", {}, data->shape()), data_(std::move(data)) {
+  SetDataBytes(xla::ShapeUtil::ByteSizeOf(shape(), sizeof(void*)));
+}
+
+std::string DeviceData::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", device=" << data_->device();
+  return ss.str();
+}
+
+XlaOpVector DeviceData::Lower(LoweringContext* loctx) const {
+  return {loctx->GetParameter(data_)};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
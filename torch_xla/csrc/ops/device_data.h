@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "ir.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Feeds the device data behind a tensor to the graph, as computation
+// parameter. The identity of the device data is not captured by the node hash,
+// so graphs which only differ by the data they are fed with hash the same.
+class DeviceData : public Node {
+ public:
+  explicit DeviceData(std::shared_ptr<xla::ComputationClient::Data> data);
+
+  std::string ToString() const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  const std::shared_ptr<xla::ComputationClient::Data>& data() const {
+    return data_;
+  }
+
+ private:
+  std::shared_ptr<xla::ComputationClient::Data> data_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,22 @@
+#include "ops/div.h"
+
+#include "helpers.h"
+#include "lowering_context.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+Div::Div(const NodePtr& input, const NodePtr& other)
+    : Node("aten::div", {NodeOperand(input), NodeOperand(other)},
+           XlaHelpers::GetPromotedShape(input->shape(), other->shape())) {}
+
+XlaOpVector Div::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input_op = loctx->GetOutputOp(operand(0));
+  xla::XlaOp other_op = loctx->GetOutputOp(operand(1));
+  return {XlaHelpers::PromotedDiv(input_op, other_op)};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Element-wise division, with the operands shapes and types promoted to a
+// common one.
+class Div : public Node {
+ public:
+  Div(const NodePtr& input, const NodePtr& other);
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
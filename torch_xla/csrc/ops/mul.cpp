@@ -0,0 +1,22 @@
+#include "ops/mul.h"
+
+#include "helpers.h"
+#include "lowering_context.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+Mul::Mul(const NodePtr& input, const NodePtr& other)
+    : Node("aten::mul", {NodeOperand(input), NodeOperand(other)},
+           XlaHelpers::GetPromotedShape(input->shape(), other->shape())) {}
+
+XlaOpVector Mul::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input_op = loctx->GetOutputOp(operand(0));
+  xla::XlaOp other_op = loctx->GetOutputOp(operand(1));
+  return {XlaHelpers::PromotedMul(input_op, other_op)};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
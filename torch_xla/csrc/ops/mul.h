@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Element-wise multiplication, with the operands shapes and types promoted
+// to a common one.
+class Mul : public Node {
+ public:
+  Mul(const NodePtr& input, const NodePtr& other);
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
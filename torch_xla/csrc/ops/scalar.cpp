@@ -0,0 +1,40 @@
+#include "ops/scalar.h"
+
+#include <sstream>
+
+#include "helpers.h"
+#include "lowering_context.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/core/lib/hash/hash.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+size_t ScalarHash(double value) {
+  return tensorflow::Hash64(reinterpret_cast<const char*>(&value),
+                            sizeof(value));
+}
+
+}  // namespace
+
+Scalar::Scalar(double value, xla::PrimitiveType type)
+    : Node("prim::Constant", {}, xla::ShapeUtil::MakeShape(type, {}),
+           /*num_outputs=*/1, ScalarHash(value)),
+      value_(value) {}
+
+std::string Scalar::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", value=" << value_;
+  return ss.str();
+}
+
+XlaOpVector Scalar::Lower(LoweringContext* loctx) const {
+  return {XlaHelpers::ScalarValue<double>(value_, shape().element_type(),
+                                          loctx->builder())};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+#include "ir.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// A scalar value baked within the computation as constant. Since the value is
+// part of the node hash, computations generated with different values will not
+// share the same compiled computation.
+class Scalar : public Node {
+ public:
+  Scalar(double value, xla::PrimitiveType type);
+
+  std::string ToString() const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  double value() const { return value_; }
+
+ private:
+  double value_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
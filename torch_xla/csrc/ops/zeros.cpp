@@ -0,0 +1,21 @@
+#include "ops/zeros.h"
+
+#include "helpers.h"
+#include "lowering_context.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+Zeros::Zeros(xla::Shape shape) : Node("aten::zeros", {}, std::move(shape)) {}
+
+XlaOpVector Zeros::Lower(LoweringContext* loctx) const {
+  xla::XlaOp zero = xla::ConstantLiteral(
+      loctx->builder(), xla::LiteralUtil::Zero(shape().element_type()));
+  return {xla::Broadcast(zero, XlaHelpers::ShapeSizes(shape()))};
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
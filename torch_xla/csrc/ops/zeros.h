@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// A tensor with the given shape, filled with zeros.
+class Zeros : public Node {
+ public:
+  explicit Zeros(xla::Shape shape);
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -2,23 +2,48 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstring>
 #include <functional>
 #include <list>
 #include <mutex>
 #include <numeric>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "helpers.h"
+#include "lowering_context.h"
+#include "ops/add.h"
+#include "ops/addcdiv.h"
+#include "ops/addcmul.h"
+#include "ops/cast.h"
+#include "ops/cross_replica_sum.h"
+#include "ops/device_data.h"
+#include "ops/div.h"
+#include "ops/mul.h"
+#include "ops/scalar.h"
+#include "ops/zeros.h"
 #include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "tensorflow/core/lib/bfloat16/bfloat16.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "torch/csrc/autograd/variable.h"
 #include "translator.h"
 
@@ -30,6 +55,10 @@ namespace {
 // is used to create XLA computation "barriers" in order to flush pending
 // operations and ensure the same XLA computations are created during the
 // training loops.
+// The arena also tracks, per device, the tensors which have a pending graph,
+// so that barriers do not need to walk all the live tensors, and indexes the
+// device data held by the tensors, so that the apply operations can map their
+// parameters back to the unique ID of the tensors owning them.
 class TensorsArena {
  public:
   static TensorsArena* Get() {
@@ -40,12 +69,148 @@ class TensorsArena {
   std::shared_ptr<XLATensor> RegisterTensor(std::shared_ptr<XLATensor> tensor) {
     std::lock_guard<std::mutex> lock(lock_);
     tensors_map_.emplace(tensor.get(), tensor);
+    if (tensor->CurrentIrNode() != nullptr) {
+      pending_map_[tensor->GetDevice()].emplace(tensor.get(), tensor);
+    }
+    UidEntry* uid_entry = &uids_map_[tensor->GetUniqueId()];
+    uid_entry->tensors.insert(tensor.get());
+    IndexData(tensor->GetUniqueId(), uid_entry,
+              tensor->CurrentXlaData().get());
     return tensor;
   }
 
-  void UnregisterTensor(XLATensor* tensor) {
+  // The orphan_pending argument tells whether the tensor being unregistered is
+  // sharing a pending graph with other tensors, which might not be tracked
+  // within the pending set.
+  void UnregisterTensor(XLATensor* tensor, bool orphan_pending) {
     std::lock_guard<std::mutex> lock(lock_);
-    tensors_map_.erase(tensor);
+    if (tensors_map_.erase(tensor) > 0) {
+      auto it = pending_map_.find(tensor->GetDevice());
+      if (it != pending_map_.end()) {
+        it->second.erase(tensor);
+      }
+      rescan_pending_ = rescan_pending_ || orphan_pending;
+      auto uid_it = uids_map_.find(tensor->GetUniqueId());
+      if (uid_it != uids_map_.end()) {
+        uid_it->second.tensors.erase(tensor);
+        if (uid_it->second.tensors.empty()) {
+          IndexData(uid_it->first, &uid_it->second, nullptr);
+          uids_map_.erase(uid_it);
+        }
+      }
+    }
+  }
+
+  // Updates the device data index, after the device data of the tensor (which
+  // is shared by all the tensors with the same unique ID) has changed. Tensors
+  // not created by the XLATensor::Create() APIs are ignored.
+  void DataChanged(XLATensor* tensor) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (tensors_map_.count(tensor) == 0) {
+      return;
+    }
+    auto uid_it = uids_map_.find(tensor->GetUniqueId());
+    if (uid_it != uids_map_.end()) {
+      IndexData(uid_it->first, &uid_it->second,
+                tensor->CurrentXlaData().get());
+    }
+  }
+
+  // Retrieves the unique ID of the tensor owning the given device data. If
+  // more tensors own it, the lowest (oldest) unique ID is returned, as the
+  // newer tensors are very likely the results of ReferenceDataFrom() calls
+  // used to update the tensors (inputs, gradients,...) with the new data,
+  // which will go away soon.
+  bool GetDataUid(const xla::ComputationClient::Data* data, xla::int64* uid) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = data_uids_.find(data);
+    if (it == data_uids_.end()) {
+      return false;
+    }
+    if (it->second.size() > 1) {
+      XLA_COUNTER("DuplicatedTensorData", 1);
+    }
+    *uid = *it->second.begin();
+    return true;
+  }
+
+  // Retrieves one live tensor for each of the unique IDs owning the given
+  // device data.
+  std::vector<std::shared_ptr<XLATensor>> GetDataOwners(
+      const xla::ComputationClient::Data* data) {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::vector<std::shared_ptr<XLATensor>> tensors;
+    auto it = data_uids_.find(data);
+    if (it != data_uids_.end()) {
+      for (auto uid : it->second) {
+        std::shared_ptr<XLATensor> tensor = GetUidTensor(uid);
+        if (tensor != nullptr) {
+          tensors.push_back(std::move(tensor));
+        }
+      }
+    }
+    return tensors;
+  }
+
+  // Retrieves one live tensor for each of the given unique IDs, or nullptr for
+  // the unique IDs which have no live tensor.
+  std::vector<std::shared_ptr<XLATensor>> GetUidTensors(
+      const std::vector<xla::int64>& uids) {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::vector<std::shared_ptr<XLATensor>> tensors;
+    tensors.reserve(uids.size());
+    for (auto uid : uids) {
+      tensors.push_back(GetUidTensor(uid));
+    }
+    return tensors;
+  }
+
+  void MarkPending(XLATensor* tensor) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = tensors_map_.find(tensor);
+    if (it != tensors_map_.end()) {
+      pending_map_[tensor->GetDevice()].emplace(tensor, it->second);
+    }
+  }
+
+  void ClearPending(XLATensor* tensor) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = pending_map_.find(tensor->GetDevice());
+    if (it != pending_map_.end()) {
+      it->second.erase(tensor);
+    }
+  }
+
+  // Retrieves the tensors with a pending graph on the given device, or on all
+  // devices if device is nullptr.
+  std::vector<std::shared_ptr<XLATensor>> GetPendingTensors(
+      const XLATensor::Device* device) {
+    // Locking a weak pointer can leave us holding the last reference to a
+    // tensor, whose destructor calls UnregisterTensor(). Such references are
+    // parked here, which is declared before the lock guard, so that they are
+    // dropped only after the lock has been released.
+    std::vector<std::shared_ptr<XLATensor>> dropped_tensors;
+    std::lock_guard<std::mutex> lock(lock_);
+    if (rescan_pending_) {
+      RescanPending(&dropped_tensors);
+    }
+    std::vector<std::shared_ptr<XLATensor>> tensors;
+    for (auto& device_pending : pending_map_) {
+      if (device != nullptr && device_pending.first != *device) {
+        continue;
+      }
+      for (auto& ptr_wptr : device_pending.second) {
+        std::shared_ptr<XLATensor> tensor = ptr_wptr.second.lock();
+        // Tensors sharing their data with others (see XLATensor::Clone()) can
+        // have been synced through one of the other tensors.
+        if (tensor != nullptr && tensor->CurrentIrNode() != nullptr) {
+          tensors.push_back(std::move(tensor));
+        } else if (tensor != nullptr) {
+          dropped_tensors.push_back(std::move(tensor));
+        }
+      }
+    }
+    return tensors;
   }
 
   std::vector<std::shared_ptr<XLATensor>> GetTensors() {
@@ -61,8 +226,78 @@ class TensorsArena {
   }
 
  private:
+  using TensorsMap = std::map<XLATensor*, std::weak_ptr<XLATensor>>;
+
+  // The live tensors sharing a unique ID, and the device data they have been
+  // indexed with.
+  struct UidEntry {
+    std::set<XLATensor*> tensors;
+    const xla::ComputationClient::Data* xla_data = nullptr;
+  };
+
+  // Returns one live tensor with the given unique ID, or nullptr. The caller
+  // must release the returned reference only after releasing lock_, as it
+  // might be the last one to the tensor.
+  std::shared_ptr<XLATensor> GetUidTensor(xla::int64 uid) {
+    auto uid_it = uids_map_.find(uid);
+    if (uid_it != uids_map_.end()) {
+      for (auto tensor_ptr : uid_it->second.tensors) {
+        std::shared_ptr<XLATensor> tensor = tensors_map_.at(tensor_ptr).lock();
+        if (tensor != nullptr) {
+          return tensor;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  // Moves the unique ID of uid_entry from the index of its current device
+  // data, to the one of xla_data (which can be nullptr).
+  void IndexData(xla::int64 uid, UidEntry* uid_entry,
+                 const xla::ComputationClient::Data* xla_data) {
+    if (uid_entry->xla_data == xla_data) {
+      return;
+    }
+    if (uid_entry->xla_data != nullptr) {
+      auto it = data_uids_.find(uid_entry->xla_data);
+      it->second.erase(uid);
+      if (it->second.empty()) {
+        data_uids_.erase(it);
+      }
+    }
+    if (xla_data != nullptr) {
+      data_uids_[xla_data].insert(uid);
+    }
+    uid_entry->xla_data = xla_data;
+  }
+
+  // Rebuilds the pending sets by walking all the live tensors. This is only
+  // needed when a tensor sharing a pending graph with others goes away. The
+  // references taken to the live tensors are moved into dropped_tensors, and
+  // must be released by the caller after releasing lock_.
+  void RescanPending(std::vector<std::shared_ptr<XLATensor>>* dropped_tensors) {
+    pending_map_.clear();
+    for (auto& ptr_wptr : tensors_map_) {
+      std::shared_ptr<XLATensor> tensor = ptr_wptr.second.lock();
+      if (tensor == nullptr) {
+        continue;
+      }
+      if (tensor->CurrentIrNode() != nullptr) {
+        pending_map_[tensor->GetDevice()].emplace(ptr_wptr);
+      }
+      dropped_tensors->push_back(std::move(tensor));
+    }
+    rescan_pending_ = false;
+    XLA_COUNTER("RescanPendingTensors", 1);
+  }
+
   std::mutex lock_;
-  std::map<XLATensor*, std::weak_ptr<XLATensor>> tensors_map_;
+  TensorsMap tensors_map_;
+  std::map<XLATensor::Device, TensorsMap> pending_map_;
+  bool rescan_pending_ = false;
+  std::unordered_map<xla::int64, UidEntry> uids_map_;
+  std::unordered_map<const xla::ComputationClient::Data*, std::set<xla::int64>>
+      data_uids_;
 };
 
 // Creates a minor-to-major layout from given dimensions.
@@ -84,28 +319,6 @@ xla::Shape MakeArrayShapeFromDimensions(
   return MakeTorchTensorLayout(dimensions, type);
 }
 
-// Copies n bytes from source to dest, with different stride values for source
-// and destination.
-template <typename S, typename D>
-void StridedCopy(D* dest, xla::int64 dest_stride, const S* source,
-                 xla::int64 source_stride, xla::int64 n) {
-  for (; n > 0; --n, dest += dest_stride, source += source_stride) {
-    *dest = static_cast<D>(*source);
-  }
-}
-
-// Computes the offset of the value at a given index, assuming a contiguous/flat
-// tensor data representation.
-template <typename S>
-xla::int64 GetFlatTensorOffset(const S& strides,
-                               const std::vector<xla::int64>& indices) {
-  xla::int64 base = 0;
-  for (size_t i = 0; i < indices.size(); ++i) {
-    base += indices[i] * strides[i];
-  }
-  return base;
-}
-
 std::vector<xla::int64> GetXlaStrides(const xla::Shape& shape) {
   std::vector<xla::int64> strides(shape.rank());
   xla::int64 stride = 1;
@@ -116,36 +329,293 @@ std::vector<xla::int64> GetXlaStrides(const xla::Shape& shape) {
   return strides;
 }
 
-template <typename D, typename S>
-void CopyData(D* dest, const S* source, xla::int64 n) {
-  StridedCopy(dest, 1, source, 1, n);
+template <typename T>
+T LoadValue(const char* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+template <typename T>
+void StoreValue(char* data, T value) {
+  std::memcpy(data, &value, sizeof(value));
+}
+
+// Converts a float to the bits of the closest bfloat16 value, rounding to
+// nearest even and mapping NaNs to the quiet NaN, like tensorflow::bfloat16
+// does. Written without branches, so that loops calling it can be vectorized.
+inline uint16_t FloatToBFloat16Bits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint16_t rounded =
+      static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+  return std::isnan(value) ? 0x7fc0 : rounded;
+}
+
+inline float BFloat16BitsToFloat(uint16_t value) {
+  uint32_t bits = static_cast<uint32_t>(value) << 16;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+template <typename S, typename D>
+D ConvertValue(S value) {
+  return static_cast<D>(value);
 }
 
 template <>
-void CopyData<float, float>(float* dest, const float* source, xla::int64 n) {
-  std::copy(source, source + n, dest);
+tensorflow::bfloat16 ConvertValue<float, tensorflow::bfloat16>(float value) {
+  tensorflow::bfloat16 result;
+  result.value = FloatToBFloat16Bits(value);
+  return result;
 }
 
 template <>
-void CopyData<xla::int64, int64_t>(xla::int64* dest, const int64_t* source,
-                                   xla::int64 n) {
-  std::copy(source, source + n, dest);
+float ConvertValue<tensorflow::bfloat16, float>(tensorflow::bfloat16 value) {
+  return BFloat16BitsToFloat(value.value);
 }
 
-std::vector<xla::int64> GetIterationDimensions(const xla::Shape& shape) {
-  // Return the most minor dimension order, to iterate the literal memory in a
-  // cache friendly way.
-  // Another strategy could be to return the higher value dimension first, to
-  // reduce the number of outer loops in TensorToLiteral(), but that leads to
-  // StridedCopy() calls in which both source and destination are jumping off
-  // memory locations.
-  return std::vector<xla::int64>(shape.layout().minor_to_major().begin(),
-                                 shape.layout().minor_to_major().end());
+// The PyTorch and XLA half types are both IEEE binary16 values.
+template <>
+xla::half ConvertValue<at::Half, xla::half>(at::Half value) {
+  xla::half result;
+  std::memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+template <>
+at::Half ConvertValue<xla::half, at::Half>(xla::half value) {
+  at::Half result;
+  std::memcpy(&result, &value, sizeof(result));
+  return result;
 }
 
+// Tells whether converting from S to D leaves the value bits untouched, like
+// between distinct integer types of the same width and signedness (such as
+// int64_t and xla::int64), or between the PyTorch and XLA half types.
+template <typename S, typename D>
+struct IsBitwiseConversion {
+  static constexpr bool value =
+      std::is_same<S, D>::value ||
+      (std::is_integral<S>::value && std::is_integral<D>::value &&
+       sizeof(S) == sizeof(D) &&
+       std::is_signed<S>::value == std::is_signed<D>::value);
+};
+
+template <>
+struct IsBitwiseConversion<at::Half, xla::half> {
+  static constexpr bool value = true;
+};
+
+template <>
+struct IsBitwiseConversion<xla::half, at::Half> {
+  static constexpr bool value = true;
+};
+
+// Converts n contiguous elements from S to D. The buffers might not be aligned
+// for S and D.
+template <typename S, typename D>
+void ConvertBlock(char* dest, const char* source, xla::int64 n) {
+  if (IsBitwiseConversion<S, D>::value) {
+    std::memcpy(dest, source, n * sizeof(S));
+  } else {
+    for (xla::int64 i = 0; i < n; ++i) {
+      StoreValue<D>(dest + i * sizeof(D),
+                    ConvertValue<S, D>(LoadValue<S>(source + i * sizeof(S))));
+    }
+  }
+}
+
+#ifdef __SSE2__
+template <>
+void ConvertBlock<float, tensorflow::bfloat16>(char* dest, const char* source,
+                                               xla::int64 n) {
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i bias = _mm_set1_epi32(0x7fff);
+  const __m128i nan = _mm_set1_epi32(0x7fc00000);
+  auto round_fn = [&](const char* data) {
+    __m128 values = _mm_loadu_ps(reinterpret_cast<const float*>(data));
+    __m128i bits = _mm_castps_si128(values);
+    __m128i lsb = _mm_and_si128(_mm_srli_epi32(bits, 16), one);
+    __m128i rounded = _mm_add_epi32(bits, _mm_add_epi32(bias, lsb));
+    __m128i nan_mask = _mm_castps_si128(_mm_cmpunord_ps(values, values));
+    rounded = _mm_or_si128(_mm_andnot_si128(nan_mask, rounded),
+                           _mm_and_si128(nan_mask, nan));
+    // The arithmetic shift keeps the 16 bit values within the signed range,
+    // so that the saturating pack below leaves them untouched.
+    return _mm_srai_epi32(rounded, 16);
+  };
+  xla::int64 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i low = round_fn(source + i * sizeof(float));
+    __m128i high = round_fn(source + (i + 4) * sizeof(float));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * sizeof(uint16_t)),
+                     _mm_packs_epi32(low, high));
+  }
+  for (; i < n; ++i) {
+    StoreValue<uint16_t>(
+        dest + i * sizeof(uint16_t),
+        FloatToBFloat16Bits(LoadValue<float>(source + i * sizeof(float))));
+  }
+}
+
+template <>
+void ConvertBlock<tensorflow::bfloat16, float>(char* dest, const char* source,
+                                               xla::int64 n) {
+  const __m128i zero = _mm_setzero_si128();
+  xla::int64 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i values = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(source + i * sizeof(uint16_t)));
+    char* dest_data = dest + i * sizeof(float);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest_data),
+                     _mm_unpacklo_epi16(zero, values));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest_data + 4 * sizeof(float)),
+                     _mm_unpackhi_epi16(zero, values));
+  }
+  for (; i < n; ++i) {
+    StoreValue<float>(dest + i * sizeof(float),
+                      BFloat16BitsToFloat(
+                          LoadValue<uint16_t>(source + i * sizeof(uint16_t))));
+  }
+}
+#endif  // __SSE2__
+
+// Minimum number of elements converted by each ConvertElements() work chunk
+// running over the XLA thread pool.
+constexpr xla::int64 kConvertChunkElements = 1024 * 1024;
+
+// Converts n contiguous elements from S to D, splitting large conversions over
+// the XLA thread pool.
+template <typename S, typename D>
+void ConvertElements(char* dest, const char* source, xla::int64 n) {
+  auto convert_fn = [&](xla::int64 start, xla::int64 end) {
+    ConvertBlock<S, D>(dest + start * sizeof(D), source + start * sizeof(S),
+                       end - start);
+  };
+  xla::xla_env::ParallelFor(n, kConvertChunkElements, convert_fn);
+}
+
+// Number of destination minor dimension indices handled by each RelayoutCopy()
+// work item when transposing.
+constexpr xla::int64 kRelayoutTileSize = 32;
+// Minimum number of elements copied by each RelayoutCopy() work chunk running
+// over the XLA thread pool.
+constexpr xla::int64 kRelayoutChunkElements = 256 * 1024;
+
+// Returns the dimension with the smallest stride, among the non degenerate
+// ones.
+xla::int64 GetMinorDimension(const std::vector<xla::int64>& strides,
+                             const std::vector<xla::int64>& dimensions) {
+  xla::int64 minor_dim = -1;
+  for (size_t i = 0; i < dimensions.size(); ++i) {
+    if (dimensions[i] > 1 &&
+        (minor_dim < 0 || strides[i] < strides[minor_dim])) {
+      minor_dim = i;
+    }
+  }
+  return minor_dim;
+}
+
+// Copies an array with the given dimensions from the source buffer, laid out
+// according to source_strides, into the dest buffer, laid out according to
+// dest_strides, converting the elements from S to D. Strides are expressed in
+// elements, and the buffers might not be aligned for S and D.
+// When source and destination have different minor dimensions (like for the
+// TPU {0,1,3,2} layout), the copy is a transpose, which is done in blocks of
+// kRelayoutTileSize destination minor indices. Walking the source minor
+// dimension within a block, the loads reuse the kRelayoutTileSize source
+// cache lines of the previous row, while the innermost loop writes
+// sequentially and can be vectorized by the compiler. Large copies are split
+// over the XLA thread pool.
+template <typename S, typename D>
+void RelayoutCopy(char* dest, const std::vector<xla::int64>& dest_strides,
+                  const char* source,
+                  const std::vector<xla::int64>& source_strides,
+                  const std::vector<xla::int64>& dimensions) {
+  xla::int64 total_elements =
+      std::accumulate(dimensions.begin(), dimensions.end(), xla::int64(1),
+                      std::multiplies<xla::int64>());
+  if (total_elements == 0) {
+    return;
+  }
+  xla::int64 source_minor = GetMinorDimension(source_strides, dimensions);
+  xla::int64 dest_minor = GetMinorDimension(dest_strides, dimensions);
+  if (source_minor < 0) {
+    StoreValue<D>(dest, ConvertValue<S, D>(LoadValue<S>(source)));
+    return;
+  }
+  std::vector<xla::int64> outer_dims;
+  xla::int64 rank = dimensions.size();
+  for (xla::int64 dim = 0; dim < rank; ++dim) {
+    if (dim != source_minor && dim != dest_minor) {
+      outer_dims.push_back(dim);
+    }
+  }
+  // Each work item covers one index of the outer dimensions, and a block of
+  // (up to) kRelayoutTileSize indices of the destination minor dimension (the
+  // columns). The source minor dimension (the rows) is walked entirely by every
+  // work item.
+  xla::int64 row_size = dimensions[source_minor];
+  xla::int64 column_size =
+      source_minor != dest_minor ? dimensions[dest_minor] : 1;
+  xla::int64 column_tile = source_minor != dest_minor ? kRelayoutTileSize : 1;
+  xla::int64 column_blocks = (column_size + column_tile - 1) / column_tile;
+  xla::int64 source_row_stride = source_strides[source_minor];
+  xla::int64 dest_row_stride = dest_strides[source_minor];
+  xla::int64 source_column_stride =
+      source_minor != dest_minor ? source_strides[dest_minor] : 0;
+  xla::int64 dest_column_stride =
+      source_minor != dest_minor ? dest_strides[dest_minor] : 0;
+  auto copy_fn = [&](xla::int64 start, xla::int64 end) {
+    for (xla::int64 item = start; item < end; ++item) {
+      xla::int64 outer_index = item / column_blocks;
+      xla::int64 column_start = (item % column_blocks) * column_tile;
+      xla::int64 columns = std::min(column_tile, column_size - column_start);
+      xla::int64 source_base = column_start * source_column_stride;
+      xla::int64 dest_base = column_start * dest_column_stride;
+      for (auto it = outer_dims.rbegin(); it != outer_dims.rend(); ++it) {
+        xla::int64 index = outer_index % dimensions[*it];
+        outer_index /= dimensions[*it];
+        source_base += index * source_strides[*it];
+        dest_base += index * dest_strides[*it];
+      }
+      if (columns == 1) {
+        for (xla::int64 row = 0; row < row_size; ++row) {
+          StoreValue<D>(
+              dest + (dest_base + row * dest_row_stride) * sizeof(D),
+              ConvertValue<S, D>(LoadValue<S>(
+                  source + (source_base + row * source_row_stride) *
+                               sizeof(S))));
+        }
+        continue;
+      }
+      for (xla::int64 row = 0; row < row_size; ++row) {
+        char* dest_row = dest + (dest_base + row * dest_row_stride) * sizeof(D);
+        const char* source_row =
+            source + (source_base + row * source_row_stride) * sizeof(S);
+        for (xla::int64 column = 0; column < columns; ++column) {
+          StoreValue<D>(
+              dest_row + column * dest_column_stride * sizeof(D),
+              ConvertValue<S, D>(LoadValue<S>(
+                  source_row + column * source_column_stride * sizeof(S))));
+        }
+      }
+    }
+  };
+  xla::int64 item_elements = row_size * column_tile;
+  xla::xla_env::ParallelFor(
+      (total_elements / row_size / column_size) * column_blocks,
+      std::max<xla::int64>(kRelayoutChunkElements / item_elements, 1),
+      copy_fn);
+}
+
+// Copies the tensor values into the dest buffer, following the layout of the
+// given shape.
 template <typename AtenNative, typename XlaNative>
-xla::Literal TensorToLiteral(const at::Tensor& tensor,
-                             const xla::Shape& shape) {
+void CopyTensorToBuffer(const at::Tensor& tensor, const xla::Shape& shape,
+                        void* dest, size_t dest_size) {
   const at::Tensor& contiguous_tensor = tensor.contiguous();
   auto contiguous_ptr = contiguous_tensor.data<AtenNative>();
   const auto& tensor_sizes = contiguous_tensor.sizes();
@@ -153,104 +623,859 @@ xla::Literal TensorToLiteral(const at::Tensor& tensor,
   xla::int64 total_elements =
       std::accumulate(tensor_sizes.begin(), tensor_sizes.end(), 1,
                       std::multiplies<xla::int64>());
-  xla::Literal literal(shape);
-  auto literal_data = literal.data<XlaNative>();
-  XLA_CHECK_EQ(literal_data.size(), total_elements);
+  XLA_CHECK_EQ(dest_size, total_elements * sizeof(XlaNative));
   if (total_elements == 1 ||
       xla::LayoutUtil::IsMonotonicWithDim0Major(shape.layout())) {
     // The Torch tensor is array layout, and so is the literal. We can issue a
     // fast copy of the elements.
-    CopyData<XlaNative, AtenNative>(literal_data.data(), contiguous_ptr,
-                                    total_elements);
+    ConvertElements<AtenNative, XlaNative>(
+        static_cast<char*>(dest), reinterpret_cast<const char*>(contiguous_ptr),
+        total_elements);
   } else {
     const auto& tensor_strides = contiguous_tensor.strides();
-    const auto& xla_tensor_strides = GetXlaStrides(shape);
-    std::vector<xla::int64> indices(tensor_sizes.size());
-    std::vector<xla::int64> iter_dims = GetIterationDimensions(shape);
-    xla::int64 n = 0;
-    while (n < tensor_sizes.size()) {
-      StridedCopy(literal_data.data() +
-                      GetFlatTensorOffset(xla_tensor_strides, indices),
-                  xla_tensor_strides[iter_dims.front()],
-                  contiguous_ptr + GetFlatTensorOffset(tensor_strides, indices),
-                  tensor_strides[iter_dims.front()],
-                  shape.dimensions(iter_dims.front()));
-      // Compute the next index. Skip the lower iteration dimension, as we loop
-      // over it using the StridedCopy() call above.
-      for (n = 1; n < iter_dims.size(); ++n) {
-        xla::int64 dim = iter_dims[n];
-        indices[dim] += 1;
-        if (indices[dim] < shape.dimensions(dim)) {
-          break;
-        }
-        indices[dim] = 0;
+    RelayoutCopy<AtenNative, XlaNative>(
+        static_cast<char*>(dest), GetXlaStrides(shape),
+        reinterpret_cast<const char*>(contiguous_ptr),
+        std::vector<xla::int64>(tensor_strides.begin(), tensor_strides.end()),
+        XlaHelpers::I64List(tensor_sizes));
+  }
+}
+
+// Writes the values of the tensor into the dest buffer, with the element type
+// and layout of the given shape. Used as TensorSource::populate_fn callback
+// for the tensor uploads.
+void PopulateTensorBuffer(const at::Tensor& tensor, const xla::Shape& shape,
+                          void* dest, size_t dest_size) {
+  switch (tensor.type().scalarType()) {
+    case at::ScalarType::Float:
+      if (shape.element_type() == xla::PrimitiveType::BF16) {
+        CopyTensorToBuffer<float, tensorflow::bfloat16>(tensor, shape, dest,
+                                                        dest_size);
+      } else {
+        CopyTensorToBuffer<float, float>(tensor, shape, dest, dest_size);
       }
-    }
+      break;
+    case at::ScalarType::Double:
+      CopyTensorToBuffer<double, double>(tensor, shape, dest, dest_size);
+      break;
+    case at::ScalarType::Half:
+      CopyTensorToBuffer<at::Half, xla::half>(tensor, shape, dest, dest_size);
+      break;
+    case at::ScalarType::Byte:
+      CopyTensorToBuffer<uint8_t, xla::uint8>(tensor, shape, dest, dest_size);
+      break;
+    case at::ScalarType::Char:
+      CopyTensorToBuffer<int8_t, xla::int8>(tensor, shape, dest, dest_size);
+      break;
+    case at::ScalarType::Short:
+      CopyTensorToBuffer<int16_t, xla::int16>(tensor, shape, dest, dest_size);
+      break;
+    case at::ScalarType::Int:
+      CopyTensorToBuffer<int32_t, xla::int32>(tensor, shape, dest, dest_size);
+      break;
+    case at::ScalarType::Long:
+      CopyTensorToBuffer<int64_t, xla::int64>(tensor, shape, dest, dest_size);
+      break;
+    default:
+      TF_LOG(FATAL) << "Tensor type not supported: "
+                    << tensor.type().scalarType();
   }
-  return literal;
 }
 
 std::shared_ptr<xla::ComputationClient::Data> TensorToXla(
     const at::Tensor& param_tensor, const xla::Shape& param_shape,
     const XLATensor::Device& device, xla::ComputationClient* client) {
-  xla::Literal literal = GetTensorLiteral(param_tensor, &param_shape);
-  std::vector<xla::ComputationClient::LiteralDevice> literal_device;
-  literal_device.emplace_back(std::move(literal), device.ToString());
-  auto handles = client->TransferToServer(literal_device);
+  auto populate_fn =
+      [&](const xla::ComputationClient::TensorSource& source_tensor,
+          void* dest_buffer, size_t dest_buffer_size) {
+        PopulateTensorBuffer(param_tensor, source_tensor.shape, dest_buffer,
+                             dest_buffer_size);
+      };
+  std::vector<xla::ComputationClient::TensorSource> source_tensors;
+  source_tensors.emplace_back(param_shape, device.ToString(),
+                              std::move(populate_fn));
+  auto handles = client->TransferTensorsToServer(source_tensors);
   XLA_CHECK_EQ(handles.size(), 1);
   return std::move(handles.front());
 }
 
-at::Tensor MakeTensorFromXlaLiteral(const xla::Literal& literal) {
-  const xla::Literal* literal_ptr = &literal;
-  xla::Literal f32_literal;
-  if (literal_ptr->shape().element_type() == xla::PrimitiveType::BF16) {
-    // If ever PyTorch will support BF16, remove this cast to F32.
-    f32_literal = xla::LiteralUtil::ConvertBF16ToF32(*literal_ptr);
-    literal_ptr = &f32_literal;
-  }
-  std::vector<int64_t> dimensions;
-  for (const auto result_dimension : literal_ptr->shape().dimensions()) {
-    dimensions.push_back(result_dimension);
-  }
-  xla::Shape torch_shape = MakeTorchTensorLayout(
-      XlaHelpers::I64List(dimensions), literal_ptr->shape().element_type());
-  xla::Literal literal_with_torch_layout;
-  if (!xla::ShapeUtil::Equal(literal_ptr->shape(), torch_shape)) {
-    literal_with_torch_layout = literal_ptr->Relayout(torch_shape);
-    literal_ptr = &literal_with_torch_layout;
-  }
-  switch (literal_ptr->shape().element_type()) {
-    case xla::PrimitiveType::F32: {
-      const auto result_slice = literal_ptr->data<float>();
-      at::Tensor result_tensor =
-          at::empty(dimensions, at::TensorOptions(at::kFloat));
-      std::copy(result_slice.begin(), result_slice.end(),
-                result_tensor.data<float>());
-      return result_tensor;
-    }
-    case xla::PrimitiveType::S64: {
-      const auto result_slice = literal_ptr->data<xla::int64>();
-      at::Tensor result_tensor =
-          at::empty(dimensions, at::TensorOptions(at::kLong));
-      std::copy(result_slice.begin(), result_slice.end(),
-                result_tensor.data<int64_t>());
-      return result_tensor;
-    }
-    default:
-      AT_ERROR("Unsupported literal type");
-  }
+// Returns the PyTorch type of the tensors holding host copies of XLA data
+// with the given element type.
+at::ScalarType TensorTypeFromXlaType(xla::PrimitiveType type) {
+  switch (type) {
+    case xla::PrimitiveType::BF16:
+    case xla::PrimitiveType::F32:
+      return at::ScalarType::Float;
+    case xla::PrimitiveType::F64:
+      return at::ScalarType::Double;
+    case xla::PrimitiveType::F16:
+      return at::ScalarType::Half;
+    case xla::PrimitiveType::PRED:
+    case xla::PrimitiveType::U8:
+      return at::ScalarType::Byte;
+    case xla::PrimitiveType::S8:
+      return at::ScalarType::Char;
+    case xla::PrimitiveType::S16:
+      return at::ScalarType::Short;
+    case xla::PrimitiveType::S32:
+      return at::ScalarType::Int;
+    case xla::PrimitiveType::S64:
+      return at::ScalarType::Long;
+    default:
+      AT_ERROR("Unsupported literal type");
+  }
+}
+
+// Copies the values stored within the source buffer, following the layout of
+// the given shape, into the dest tensor storage, which is in row-major order.
+// The source buffer might not be aligned for the XlaNative type.
+template <typename XlaNative, typename AtenNative>
+void CopyBufferToTensor(const void* source, const xla::Shape& shape,
+                        AtenNative* dest) {
+  const char* source_data = static_cast<const char*>(source);
+  xla::int64 total_elements = xla::ShapeUtil::ElementsIn(shape);
+  if (total_elements == 1 ||
+      xla::LayoutUtil::IsMonotonicWithDim0Major(shape.layout())) {
+    ConvertElements<XlaNative, AtenNative>(reinterpret_cast<char*>(dest),
+                                           source_data, total_elements);
+  } else {
+    std::vector<xla::int64> dimensions(shape.dimensions().begin(),
+                                       shape.dimensions().end());
+    xla::Shape torch_shape =
+        MakeTorchTensorLayout(dimensions, shape.element_type());
+    RelayoutCopy<XlaNative, AtenNative>(reinterpret_cast<char*>(dest),
+                                        GetXlaStrides(torch_shape), source_data,
+                                        GetXlaStrides(shape), dimensions);
+  }
+}
+
+// Creates an ATEN tensor out of the values stored within the data buffer,
+// following the shape layout. The tensor is written in a single pass, which
+// also takes care of the relayout and of the element type conversion.
+at::Tensor MakeTensorFromXlaBuffer(const xla::Shape& shape, const void* data,
+                                   size_t size) {
+  XLA_CHECK_EQ(size, xla::ShapeUtil::ByteSizeOf(shape));
+  std::vector<int64_t> dimensions(shape.dimensions().begin(),
+                                  shape.dimensions().end());
+  at::Tensor result_tensor = at::empty(
+      dimensions,
+      at::TensorOptions(TensorTypeFromXlaType(shape.element_type())));
+  switch (shape.element_type()) {
+    case xla::PrimitiveType::F32:
+      CopyBufferToTensor<float, float>(data, shape,
+                                       result_tensor.data<float>());
+      break;
+    case xla::PrimitiveType::BF16:
+      // If ever PyTorch will support BF16, remove this cast to F32.
+      CopyBufferToTensor<tensorflow::bfloat16, float>(
+          data, shape, result_tensor.data<float>());
+      break;
+    case xla::PrimitiveType::F64:
+      CopyBufferToTensor<double, double>(data, shape,
+                                         result_tensor.data<double>());
+      break;
+    case xla::PrimitiveType::F16:
+      CopyBufferToTensor<xla::half, at::Half>(data, shape,
+                                              result_tensor.data<at::Half>());
+      break;
+    case xla::PrimitiveType::PRED:
+    case xla::PrimitiveType::U8:
+      CopyBufferToTensor<xla::uint8, uint8_t>(data, shape,
+                                              result_tensor.data<uint8_t>());
+      break;
+    case xla::PrimitiveType::S8:
+      CopyBufferToTensor<xla::int8, int8_t>(data, shape,
+                                            result_tensor.data<int8_t>());
+      break;
+    case xla::PrimitiveType::S16:
+      CopyBufferToTensor<xla::int16, int16_t>(data, shape,
+                                              result_tensor.data<int16_t>());
+      break;
+    case xla::PrimitiveType::S32:
+      CopyBufferToTensor<xla::int32, int32_t>(data, shape,
+                                              result_tensor.data<int32_t>());
+      break;
+    case xla::PrimitiveType::S64:
+      CopyBufferToTensor<xla::int64, int64_t>(data, shape,
+                                              result_tensor.data<int64_t>());
+      break;
+    default:
+      AT_ERROR("Unsupported literal type");
+  }
+  return result_tensor;
+}
+
+at::Tensor MakeTensorFromXlaLiteral(const xla::Literal& literal) {
+  return MakeTensorFromXlaBuffer(literal.shape(), literal.untyped_data(),
+                                 literal.size_bytes());
+}
+
+// Fetches the device data behind the handles straight into ATEN tensors.
+std::vector<at::Tensor> FetchTensors(
+    const std::vector<std::shared_ptr<xla::ComputationClient::Data>>&
+        handles) {
+  std::vector<at::Tensor> tensors(handles.size());
+  auto consumer_fn = [&](size_t index, const xla::Shape& shape,
+                         const void* data, size_t size) {
+    tensors[index] = MakeTensorFromXlaBuffer(shape, data, size);
+  };
+  XlaGetClient()->TransferTensorsFromServer(handles, consumer_fn);
+  return tensors;
+}
+
+std::string DeviceTypeToString(const XLATensor::DeviceType hw_type) {
+  switch (hw_type) {
+    case XLATensor::DeviceType::CPU:
+      return "CPU";
+    case XLATensor::DeviceType::GPU:
+      return "GPU";
+    case XLATensor::DeviceType::TPU:
+      return "TPU";
+  }
+}
+
+// Whether scalar operands (like learning rates) should be uploaded to device
+// and fed to the computations as parameters, instead of being baked into them
+// as constants. Changing the value of a scalar parameter does not change the
+// computation, so it does not trigger a new compilation.
+bool ScalarsAsParameters() {
+  static bool scalars_as_parameters =
+      xla::sys_util::GetEnvInt("XLA_SCALARS_AS_PARAMETERS", 0) != 0;
+  return scalars_as_parameters;
+}
+
+struct ScalarDataKey {
+  bool operator==(const ScalarDataKey& rhs) const {
+    return value_bits == rhs.value_bits && type == rhs.type &&
+           device == rhs.device;
+  }
+
+  xla::uint64 value_bits;
+  xla::PrimitiveType type;
+  std::string device;
+};
+
+struct ScalarDataKeyHasher {
+  size_t operator()(const ScalarDataKey& key) const {
+    size_t hash = tensorflow::Hash64Combine(key.value_bits, key.type);
+    return tensorflow::Hash64Combine(hash, tensorflow::Hash64(key.device));
+  }
+};
+
+using ScalarDataCache =
+    xla::util::Cache<ScalarDataKey,
+                     std::shared_ptr<xla::ComputationClient::Data>,
+                     ScalarDataKeyHasher>;
+
+ScalarDataCache* GetScalarDataCache() {
+  static ScalarDataCache* cache = new ScalarDataCache(
+      xla::sys_util::GetEnvInt("XLA_SCALAR_DATA_CACHE_SIZE", 256));
+  return cache;
+}
+
+// Maps the device data uploaded by GetScalarData() back to its scalar data
+// key. Scalar device data is not owned by any tensor, so the apply operations
+// use the index to recognize the parameters they need to gather from the
+// graphs, rather than from the tensors arena.
+class ScalarDataIndex {
+ public:
+  static ScalarDataIndex* Get() {
+    static ScalarDataIndex* index = new ScalarDataIndex();
+    return index;
+  }
+
+  void Add(const std::shared_ptr<xla::ComputationClient::Data>& data,
+           const ScalarDataKey& key) {
+    std::lock_guard<std::mutex> lock(lock_);
+    // The index holds weak references, and the device data evicted from the
+    // scalar data cache is dropped once the index doubles in size.
+    if (index_.size() >= 2 * next_prune_size_) {
+      for (auto it = index_.begin(); it != index_.end();) {
+        it = it->second.data.expired() ? index_.erase(it) : std::next(it);
+      }
+      next_prune_size_ = std::max<size_t>(index_.size(), 16);
+    }
+    index_[data.get()] = {key, data};
+  }
+
+  // Returns the scalar device data at the data address, filling up its key,
+  // or nullptr if data is not scalar device data.
+  std::shared_ptr<xla::ComputationClient::Data> Find(
+      const xla::ComputationClient::Data* data, ScalarDataKey* key) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = index_.find(data);
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    // A stale entry might match the address of new device data.
+    std::shared_ptr<xla::ComputationClient::Data> scalar_data =
+        it->second.data.lock();
+    if (scalar_data.get() != data) {
+      return nullptr;
+    }
+    *key = it->second.key;
+    return scalar_data;
+  }
+
+ private:
+  struct IndexEntry {
+    ScalarDataKey key;
+    std::weak_ptr<xla::ComputationClient::Data> data;
+  };
+
+  std::mutex lock_;
+  std::unordered_map<const xla::ComputationClient::Data*, IndexEntry> index_;
+  size_t next_prune_size_ = 16;
+};
+
+// Retrieves the device data holding the given scalar value, uploading it only
+// if not already present within the scalar data cache.
+std::shared_ptr<xla::ComputationClient::Data> GetScalarData(
+    double value, xla::PrimitiveType type, const std::string& device) {
+  ScalarDataKey key{0, type, device};
+  static_assert(sizeof(key.value_bits) == sizeof(value),
+                "Scalar value and its bits representation size mismatch");
+  std::memcpy(&key.value_bits, &value, sizeof(value));
+  auto cached_data = GetScalarDataCache()->Get(key);
+  if (cached_data != nullptr) {
+    return *cached_data;
+  }
+  XLA_COUNTER("ScalarDataCacheMiss", 1);
+  std::vector<xla::ComputationClient::LiteralDevice> literal_device;
+  literal_device.emplace_back(
+      xla::LiteralUtil::CreateR0<double>(value)
+          .Convert(type)
+          .ConsumeValueOrDie(),
+      device);
+  auto handles = XlaGetClient()->TransferToServer(literal_device);
+  XLA_CHECK_EQ(handles.size(), 1);
+  ScalarDataIndex::Get()->Add(handles.front(), key);
+  GetScalarDataCache()->Add(std::move(key), handles.front());
+  return handles.front();
+}
+
+// A computation compiled by the ApplyPendingGraph() APIs, cached by the
+// fingerprint of the graphs it has been generated from.
+struct CachedApplyComputation {
+  CachedApplyComputation(
+      std::shared_ptr<xla::ComputationClient::Computation> computation,
+      std::vector<size_t> parameters_mapping)
+      : computation(std::move(computation)),
+        parameters_mapping(std::move(parameters_mapping)) {}
+
+  std::shared_ptr<xla::ComputationClient::Computation> computation;
+  // The i-th computation parameter is fed with the device data at position
+  // parameters_mapping[i] of the fingerprint parameters_data vector.
+  std::vector<size_t> parameters_mapping;
+};
+
+using ApplyComputationCache =
+    xla::util::Cache<tensorflow::Fprint128,
+                     std::shared_ptr<CachedApplyComputation>,
+                     tensorflow::Fprint128Hasher>;
+
+// Looking up the compiled computation by graph fingerprint, allows the apply
+// operations to skip building the XLA computation, and the serialization
+// needed to lookup the computation client compilation cache.
+ApplyComputationCache* GetApplyComputationCache() {
+  static ApplyComputationCache* cache = new ApplyComputationCache(
+      xla::sys_util::GetEnvInt("XLA_APPLY_COMPUTATION_CACHE_SIZE", 128));
+  return cache;
+}
+
+// The donation_hash describes the results passed through the computation, and
+// the ones aliased to the parameters (see HashDonationPlan()). The two halves
+// of the key are computed from the independent graph fingerprint hashes.
+tensorflow::Fprint128 GetApplyCacheKey(const ir::GraphFingerprint& fingerprint,
+                                       const std::string& device,
+                                       bool tuple_result,
+                                       size_t donation_hash) {
+  size_t key = tensorflow::Hash64Combine(fingerprint.hash,
+                                         tensorflow::Hash64(device));
+  key = tensorflow::Hash64Combine(key, tuple_result ? 1 : 0);
+  xla::uint64 sequence_key = tensorflow::FingerprintCat64(
+      fingerprint.sequence_hash, tensorflow::Fingerprint64(device));
+  sequence_key = tensorflow::FingerprintCat64(sequence_key, tuple_result);
+  return {tensorflow::Hash64Combine(key, donation_hash),
+          tensorflow::FingerprintCat64(sequence_key, donation_hash)};
+}
+
+// Even if unlikely with a 128 bit key, before reusing a cached computation,
+// verify that the graph parameters and results match the ones it has been
+// compiled for.
+bool IsApplyComputationCompatible(
+    const CachedApplyComputation& cached,
+    const ir::GraphFingerprint& fingerprint,
+    const std::vector<const xla::Shape*>& result_shapes) {
+  const xla::ProgramShape& program_shape = cached.computation->program_shape();
+  if (cached.parameters_mapping.size() !=
+      static_cast<size_t>(program_shape.parameters_size())) {
+    return false;
+  }
+  // The tuple results can be followed by the parameters passed through the
+  // computation.
+  const xla::Shape& result = program_shape.result();
+  if (result.IsTuple()) {
+    if (result.tuple_shapes_size() <
+        static_cast<xla::int64>(result_shapes.size())) {
+      return false;
+    }
+    for (size_t i = 0; i < result_shapes.size(); ++i) {
+      if (!xla::ShapeUtil::Compatible(result.tuple_shapes(i),
+                                      *result_shapes[i])) {
+        return false;
+      }
+    }
+  } else if (result_shapes.size() != 1 ||
+             !xla::ShapeUtil::Compatible(result, *result_shapes.front())) {
+    return false;
+  }
+  for (size_t i = 0; i < cached.parameters_mapping.size(); ++i) {
+    size_t position = cached.parameters_mapping[i];
+    if (position >= fingerprint.parameters_data.size() ||
+        !xla::ShapeUtil::Compatible(
+            fingerprint.parameters_data[position]->shape(),
+            program_shape.parameters(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::shared_ptr<CachedApplyComputation> FindApplyComputation(
+    const tensorflow::Fprint128& key, const ir::GraphFingerprint& fingerprint,
+    const std::vector<const xla::Shape*>& result_shapes) {
+  auto cached_ptr = GetApplyComputationCache()->Get(key);
+  if (cached_ptr == nullptr) {
+    XLA_COUNTER("ApplyComputationCacheMiss", 1);
+    return nullptr;
+  }
+  if (!IsApplyComputationCompatible(**cached_ptr, fingerprint,
+                                    result_shapes)) {
+    XLA_COUNTER("ApplyComputationCacheCollision", 1);
+    return nullptr;
+  }
+  XLA_COUNTER("ApplyComputationCacheHit", 1);
+  return *cached_ptr;
+}
+
+// Creates the mapping from the computation parameters, to the position of their
+// device data within the fingerprint parameters_data vector.
+std::vector<size_t> GetParametersMapping(
+    const ir::GraphFingerprint& fingerprint,
+    const std::vector<xla::ComputationClient::Data*>& parameters_data) {
+  std::unordered_map<xla::ComputationClient::Data*, size_t> data_positions;
+  for (size_t i = 0; i < fingerprint.parameters_data.size(); ++i) {
+    data_positions.emplace(fingerprint.parameters_data[i], i);
+  }
+  std::vector<size_t> parameters_mapping;
+  parameters_mapping.reserve(parameters_data.size());
+  for (auto data : parameters_data) {
+    auto it = data_positions.find(data);
+    XLA_CHECK(it != data_positions.end());
+    parameters_mapping.push_back(it->second);
+  }
+  return parameters_mapping;
+}
+
+std::vector<xla::ComputationClient::Data*> GetMappedParameters(
+    const ir::GraphFingerprint& fingerprint,
+    const std::vector<size_t>& parameters_mapping) {
+  std::vector<xla::ComputationClient::Data*> parameters_data;
+  parameters_data.reserve(parameters_mapping.size());
+  for (auto position : parameters_mapping) {
+    parameters_data.push_back(fingerprint.parameters_data.at(position));
+  }
+  return parameters_data;
+}
+
+// Whether the ApplyPendingGraph() API for multiple tensors should return as
+// soon as the tensors have been set up with placeholder data, with the actual
+// build, compile and execution happening in background.
+bool AsyncApply() {
+  static bool async_apply =
+      xla::sys_util::GetEnvInt("XLA_ASYNC_APPLY", 0) != 0;
+  return async_apply;
+}
+
+// Placeholder for the device data which will be produced by an asynchronous
+// apply operation. Placeholders can be used as parameters of new graphs, and
+// get replaced with the real device data only when handed over to the
+// computation client.
+class AsyncXlaData : public xla::ComputationClient::Data {
+ public:
+  AsyncXlaData(std::string device, xla::Shape shape,
+               std::shared_ptr<xla::xla_util::MultiWait> mwait)
+      : Data(std::move(device), std::move(shape)), mwait_(std::move(mwait)) {}
+
+  // Waits for the asynchronous apply to complete, and returns the device data.
+  const std::shared_ptr<xla::ComputationClient::Data>& Get() const {
+    XLA_CHECK_OK(mwait_->Wait());
+    XLA_CHECK(data_ != nullptr);
+    return data_;
+  }
+
+  void Set(std::shared_ptr<xla::ComputationClient::Data> data) {
+    data_ = std::move(data);
+    ready_ = true;
+  }
+
+  // Returns whether the device data has been set, and the placeholder is the
+  // only one holding it. Does not wait for the asynchronous apply.
+  bool IsSoleHolder() const { return ready_ && data_.use_count() == 1; }
+
+ private:
+  std::shared_ptr<xla::xla_util::MultiWait> mwait_;
+  std::shared_ptr<xla::ComputationClient::Data> data_;
+  std::atomic<bool> ready_{false};
+};
+
+// Tracks the last asynchronous apply operation. Only one asynchronous apply
+// operation is allowed to be in flight, so that its execution does not
+// require more thread pool resources than the synchronous one.
+class AsyncApplyTracker {
+ public:
+  static AsyncApplyTracker* Get() {
+    static AsyncApplyTracker* tracker = new AsyncApplyTracker();
+    return tracker;
+  }
+
+  // Waits for the last asynchronous apply operation to complete, and registers
+  // mwait as the new one to be waited for. Throws if the last apply failed, in
+  // which case mwait is not registered, and the failure is reported only once.
+  void WaitAndSet(std::shared_ptr<xla::xla_util::MultiWait> mwait) {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::shared_ptr<xla::xla_util::MultiWait> last_mwait =
+        std::move(last_mwait_);
+    last_mwait_ = nullptr;
+    if (last_mwait != nullptr) {
+      XLA_CHECK_OK(last_mwait->Wait());
+    }
+    last_mwait_ = std::move(mwait);
+  }
+
+  // Waits for the last asynchronous apply operation to complete, and returns
+  // its status.
+  xla::Status Wait() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return last_mwait_ != nullptr ? last_mwait_->Wait() : xla::Status::OK();
+  }
+
+ private:
+  std::mutex lock_;
+  std::shared_ptr<xla::xla_util::MultiWait> last_mwait_;
+};
+
+// Returns the device data to be fed to the computation client, in place of the
+// data argument, waiting for it in case data is a placeholder.
+xla::ComputationClient::Data* ResolveData(xla::ComputationClient::Data* data) {
+  const AsyncXlaData* async_data = dynamic_cast<const AsyncXlaData*>(data);
+  return async_data != nullptr ? async_data->Get().get() : data;
+}
+
+void ResolveParameters(
+    std::vector<xla::ComputationClient::Data*>* parameters_data) {
+  for (auto& data : *parameters_data) {
+    data = ResolveData(data);
+  }
+}
+
+// Whether the apply operations are allowed to hand over the device memory of
+// the input parameters to the computation executions.
+bool DonateInputBuffers() {
+  static bool donate_input_buffers =
+      xla::sys_util::GetEnvInt("XLA_DONATE_INPUT_BUFFERS", 1) != 0;
+  return donate_input_buffers;
+}
+
+// Returns whether the device data can be handed over to an execution, given
+// the number of references to it the apply operation accounts for. A resolved
+// placeholder can be handed over if it is the only holder of the device data,
+// while an unresolved one cannot, as checking does not wait for it.
+bool IsDonatable(const std::shared_ptr<xla::ComputationClient::Data>& data,
+                 long accounted_uses) {
+  if (data.use_count() != accounted_uses) {
+    return false;
+  }
+  const AsyncXlaData* async_data =
+      dynamic_cast<const AsyncXlaData*>(data.get());
+  return async_data == nullptr || async_data->IsSoleHolder();
+}
+
+// Describes how an apply computation takes over the device data feeding it.
+// The computation results are the values of the tensors being applied,
+// followed by the parameters still owned by other tensors after the apply,
+// which are passed through the computation, so that the execution can release
+// all its input handles.
+struct DonationPlan {
+  bool donate = false;
+  // For each tensor result, the fingerprint position of the parameter holding
+  // the current device data of the tensor (whose buffer the result can reuse),
+  // or -1.
+  std::vector<xla::int64> result_positions;
+  // The fingerprint positions of the parameters passed through, with the
+  // tensors which need to be pointed to the returned device data.
+  std::map<size_t, std::vector<std::shared_ptr<XLATensor>>> passthrough_owners;
+};
+
+// Checks whether all the device data feeding the graphs of the tensors at
+// indices can be donated, without waiting for placeholders. This requires
+// every device data to be referenced only by the graphs parameter nodes, and
+// by the tensors owning it, which must either be overwritten by the apply, or
+// have no pending graph (so they can take the passed through device data).
+DonationPlan PlanDonation(
+    const std::vector<std::shared_ptr<XLATensor>>& tensors,
+    const std::vector<size_t>& indices,
+    const ir::GraphFingerprint& fingerprint) {
+  DonationPlan plan;
+  std::unordered_map<xla::ComputationClient::Data*, size_t> data_positions;
+  for (size_t i = 0; i < fingerprint.parameters_data.size(); ++i) {
+    data_positions.emplace(fingerprint.parameters_data[i], i);
+  }
+  std::set<xla::int64> applied_uids;
+  for (auto i : indices) {
+    applied_uids.insert(tensors[i]->GetUniqueId());
+    auto it = data_positions.find(tensors[i]->CurrentXlaData().get());
+    plan.result_positions.push_back(
+        it != data_positions.end() ? static_cast<xla::int64>(it->second) : -1);
+  }
+  for (size_t i = 0; i < fingerprint.parameters_data.size(); ++i) {
+    std::vector<std::shared_ptr<XLATensor>> owners =
+        TensorsArena::Get()->GetDataOwners(fingerprint.parameters_data[i]);
+    if (owners.empty() ||
+        !IsDonatable(owners.front()->CurrentXlaData(),
+                     fingerprint.parameters_uses[i] + owners.size())) {
+      return DonationPlan();
+    }
+    std::vector<std::shared_ptr<XLATensor>> passthrough_owners;
+    for (auto& owner : owners) {
+      if (owner->CurrentIrNode() == nullptr) {
+        passthrough_owners.push_back(std::move(owner));
+      } else if (applied_uids.count(owner->GetUniqueId()) == 0) {
+        return DonationPlan();
+      }
+    }
+    if (!passthrough_owners.empty()) {
+      plan.passthrough_owners.emplace(i, std::move(passthrough_owners));
+    }
+  }
+  plan.donate = true;
+  return plan;
+}
+
+// Returns the computation parameters passed through the computation, in
+// parameter number order, which is the order their results follow the tensors
+// ones.
+std::vector<size_t> GetPassthroughParams(
+    const DonationPlan& plan, const std::vector<size_t>& parameters_mapping) {
+  std::vector<size_t> passthrough_params;
+  for (size_t i = 0; i < parameters_mapping.size(); ++i) {
+    if (plan.passthrough_owners.count(parameters_mapping[i]) > 0) {
+      passthrough_params.push_back(i);
+    }
+  }
+  return passthrough_params;
+}
+
+// Adds the passed through parameters to the computation results, and aliases
+// the results with the parameters whose buffers they can reuse, once the
+// execution has taken them over.
+void AddDonationResults(
+    const DonationPlan& plan, const std::vector<size_t>& parameters_mapping,
+    const std::vector<size_t>& passthrough_params,
+    const std::vector<const xla::Shape*>& result_shapes,
+    const std::vector<xla::ComputationClient::Data*>& parameters_data,
+    ir::LoweringContext* lowering_ctx) {
+  std::unordered_map<size_t, xla::int64> position_params;
+  for (size_t i = 0; i < parameters_mapping.size(); ++i) {
+    position_params.emplace(parameters_mapping[i], i);
+  }
+  std::set<xla::int64> aliased_params;
+  for (size_t i = 0; i < result_shapes.size(); ++i) {
+    xla::int64 position = plan.result_positions[i];
+    if (position < 0 || plan.passthrough_owners.count(position) > 0) {
+      continue;
+    }
+    xla::int64 param = position_params.at(position);
+    if (xla::ShapeUtil::Compatible(parameters_data[param]->shape(),
+                                   *result_shapes[i]) &&
+        aliased_params.insert(param).second) {
+      lowering_ctx->builder()->SetUpAlias({static_cast<xla::int64>(i)}, param,
+                                          {});
+    }
+  }
+  for (auto param : passthrough_params) {
+    const std::shared_ptr<XLATensor>& owner =
+        plan.passthrough_owners.at(parameters_mapping[param]).front();
+    xla::int64 result = lowering_ctx->AddResult(
+        lowering_ctx->GetParameter(owner->CurrentXlaData()));
+    lowering_ctx->builder()->SetUpAlias({result}, param, {});
+  }
+}
+
+// Like PlanDonation(), checks whether the device data feeding a cached apply
+// computation, which has been built to take it over, can still be donated.
+// The parameters vector holds one more reference to each device data. Fills
+// passthrough_owners with the tensors owning the device data of the
+// passthrough_params.
+bool PlanCachedDonation(
+    const std::vector<std::shared_ptr<xla::ComputationClient::Data>>&
+        parameters,
+    const std::vector<size_t>& parameters_uses,
+    const std::vector<size_t>& passthrough_params,
+    const std::unordered_map<xla::int64, size_t>& applied_uids,
+    std::vector<std::vector<std::shared_ptr<XLATensor>>>* passthrough_owners) {
+  std::vector<std::vector<std::shared_ptr<XLATensor>>> kept_owners(
+      parameters.size());
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    std::vector<std::shared_ptr<XLATensor>> owners =
+        TensorsArena::Get()->GetDataOwners(parameters[i].get());
+    if (owners.empty() ||
+        !IsDonatable(parameters[i], parameters_uses[i] + owners.size() + 1)) {
+      return false;
+    }
+    for (auto& owner : owners) {
+      if (owner->CurrentIrNode() == nullptr) {
+        kept_owners[i].push_back(std::move(owner));
+      } else if (applied_uids.count(owner->GetUniqueId()) == 0) {
+        return false;
+      }
+    }
+  }
+  for (auto param : passthrough_params) {
+    passthrough_owners->push_back(std::move(kept_owners[param]));
+  }
+  // Device data still owned by someone after the apply, must be passed through
+  // the computation.
+  return std::all_of(
+      kept_owners.begin(), kept_owners.end(),
+      [](const std::vector<std::shared_ptr<XLATensor>>& owners) {
+        return owners.empty();
+      });
+}
+
+size_t HashDonationPlan(const DonationPlan& plan) {
+  if (!plan.donate) {
+    return 0;
+  }
+  size_t hash = tensorflow::Hash64(
+      reinterpret_cast<const char*>(plan.result_positions.data()),
+      plan.result_positions.size() * sizeof(xla::int64));
+  for (auto& position_owners : plan.passthrough_owners) {
+    hash = tensorflow::Hash64Combine(hash, position_owners.first);
+  }
+  return tensorflow::Hash64Combine(hash, plan.passthrough_owners.size());
+}
+
+// Gathers the device data feeding the scalar_parameters of a cached apply
+// computation, from the current graphs of the tensors at indices. Returns false
+// if the graphs do not match the ones the computation was generated from.
+bool GetScalarParameters(
+    const std::vector<std::shared_ptr<XLATensor>>& tensors,
+    const std::vector<size_t>& indices, size_t graph_hash,
+    const std::vector<XLATensor::ApplyContext::ScalarParameter>&
+        scalar_parameters,
+    std::vector<std::shared_ptr<xla::ComputationClient::Data>>* scalar_data) {
+  std::vector<const ir::Node*> roots;
+  roots.reserve(indices.size());
+  for (auto i : indices) {
+    roots.push_back(tensors[i]->CurrentIrNode().get());
+  }
+  ir::GraphFingerprint fingerprint = ir::ComputeGraphFingerprint(roots);
+  if (fingerprint.hash != graph_hash) {
+    return false;
+  }
+  for (auto& scalar_parameter : scalar_parameters) {
+    if (scalar_parameter.position >= fingerprint.parameters_data.size()) {
+      return false;
+    }
+    ScalarDataKey key;
+    std::shared_ptr<xla::ComputationClient::Data> data =
+        ScalarDataIndex::Get()->Find(
+            fingerprint.parameters_data[scalar_parameter.position], &key);
+    if (data == nullptr || key.type != scalar_parameter.type) {
+      return false;
+    }
+    scalar_data->push_back(std::move(data));
+  }
+  return true;
+}
+
+size_t GetUidOrderHash(const std::vector<xla::int64>& uid_order) {
+  return tensorflow::Hash64(reinterpret_cast<const char*>(uid_order.data()),
+                            uid_order.size() * sizeof(xla::int64));
+}
+
+// Looks up the apply context entry for uid_order, and moves it to the front of
+// the entries list. Returns nullptr if no entry is found.
+const XLATensor::ApplyContext::Entry* FindApplyContextEntry(
+    XLATensor::ApplyContext* apply_context, size_t uid_order_hash,
+    const std::vector<xla::int64>& uid_order) {
+  auto& entries = apply_context->entries;
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->uid_order_hash == uid_order_hash && it->uid_order == uid_order) {
+      entries.splice(entries.begin(), entries, it);
+      XLA_COUNTER("ApplyContextHit", 1);
+      return &entries.front();
+    }
+  }
+  XLA_COUNTER("ApplyContextMiss", 1);
+  return nullptr;
+}
+
+void EraseApplyContextEntry(XLATensor::ApplyContext* apply_context,
+                            size_t uid_order_hash,
+                            const std::vector<xla::int64>& uid_order) {
+  apply_context->entries.remove_if(
+      [&](const XLATensor::ApplyContext::Entry& entry) {
+        return entry.uid_order_hash == uid_order_hash &&
+               entry.uid_order == uid_order;
+      });
+}
+
+void AddApplyContextEntry(XLATensor::ApplyContext* apply_context,
+                          XLATensor::ApplyContext::Entry entry) {
+  static const size_t kMaxApplyContextEntries =
+      xla::sys_util::GetEnvInt("XLA_APPLY_CONTEXT_SIZE", 8);
+  auto& entries = apply_context->entries;
+  entries.push_front(std::move(entry));
+  while (entries.size() > kMaxApplyContextEntries) {
+    entries.pop_back();
+    XLA_COUNTER("ApplyContextEviction", 1);
+  }
+}
+
+// The limits past which the pending graph of a tensor gets cut. A zero limit
+// disables the corresponding check.
+struct GraphCutPolicy {
+  // The number of unique nodes within the graph.
+  xla::int64 max_size;
+  // The estimated cost of the graph (see ir::Node::graph_cost()).
+  xla::int64 max_cost;
+  // The bytes of device data the graph keeps alive.
+  xla::int64 max_data_bytes;
+};
+
+const GraphCutPolicy& GetGraphCutPolicy() {
+  static GraphCutPolicy* policy = new GraphCutPolicy{
+      xla::sys_util::GetEnvInt("XLA_MAX_PENDING_GRAPH_SIZE", 1000),
+      xla::sys_util::GetEnvInt("XLA_MAX_PENDING_GRAPH_COST", 0),
+      xla::sys_util::GetEnvInt("XLA_MAX_PENDING_GRAPH_BYTES", 0)};
+  return *policy;
+}
+
+bool ExceedsLimit(xla::int64 value, xla::int64 limit) {
+  return limit > 0 && value > limit;
 }
 
-std::string DeviceTypeToString(const XLATensor::DeviceType hw_type) {
-  switch (hw_type) {
-    case XLATensor::DeviceType::CPU:
-      return "CPU";
-    case XLATensor::DeviceType::GPU:
-      return "GPU";
-    case XLATensor::DeviceType::TPU:
-      return "TPU";
-  }
+// Checks the graph rooted at node against the cut policy. The node statistics
+// are upper bounds, so the caller needs to refresh them before making the
+// final decision.
+bool ExceedsGraphCutPolicy(const ir::Node& node) {
+  const GraphCutPolicy& policy = GetGraphCutPolicy();
+  return ExceedsLimit(node.graph_size(), policy.max_size) ||
+         ExceedsLimit(node.graph_cost(), policy.max_cost) ||
+         ExceedsLimit(node.graph_data_bytes(), policy.max_data_bytes);
 }
 
 void SetMulti(const std::vector<std::shared_ptr<XLATensor>>& dest_tuple,
@@ -266,6 +1491,26 @@ void SetMulti(const std::vector<std::shared_ptr<XLATensor>>& dest_tuple,
   }
 }
 
+// Sets the results of an apply computation execution: the first ones to the
+// tensors at index_mapping, and the ones passed through the computation to
+// the tensors owning the input device data.
+void SetApplyResults(
+    const std::vector<std::shared_ptr<XLATensor>>& tensors,
+    std::vector<std::shared_ptr<xla::ComputationClient::Data>> results,
+    const std::vector<size_t>& index_mapping,
+    const std::vector<std::vector<std::shared_ptr<XLATensor>>>&
+        passthrough_owners) {
+  XLA_CHECK_EQ(results.size(),
+               index_mapping.size() + passthrough_owners.size());
+  for (size_t i = 0; i < passthrough_owners.size(); ++i) {
+    for (auto& owner : passthrough_owners[i]) {
+      owner->SetXlaData(results[index_mapping.size() + i]);
+    }
+  }
+  results.resize(index_mapping.size());
+  SetMulti(tensors, std::move(results), index_mapping);
+}
+
 }  // namespace
 
 std::string XLATensor::Device::ToString() const {
@@ -285,10 +1530,14 @@ std::shared_ptr<XLATensor> XLATensor::Create(
       std::make_shared<XLATensor>(std::move(xla_data), requires_grad));
 }
 
-std::shared_ptr<XLATensor> XLATensor::Create(
-    std::shared_ptr<XlaGraphNode> xla_graph_node, const Device& device) {
-  return TensorsArena::Get()->RegisterTensor(
-      std::make_shared<XLATensor>(std::move(xla_graph_node), device));
+std::shared_ptr<XLATensor> XLATensor::Create(ir::NodePtr ir_node,
+                                             const Device& device) {
+  std::shared_ptr<XLATensor> tensor = TensorsArena::Get()->RegisterTensor(
+      std::make_shared<XLATensor>(std::move(ir_node), device));
+  // The graph limits are checked only once the tensor is registered, so that
+  // it gets applied together with the other pending tensors.
+  tensor->TryLimitGraphSize();
+  return tensor;
 }
 
 std::shared_ptr<XLATensor> XLATensor::Create(std::shared_ptr<Data> data) {
@@ -296,7 +1545,10 @@ std::shared_ptr<XLATensor> XLATensor::Create(std::shared_ptr<Data> data) {
       std::make_shared<XLATensor>(std::move(data)));
 }
 
-XLATensor::~XLATensor() { TensorsArena::Get()->UnregisterTensor(this); }
+XLATensor::~XLATensor() {
+  TensorsArena::Get()->UnregisterTensor(
+      this, data_->ir_node != nullptr && data_.use_count() > 1);
+}
 
 XLATensor::XLATensor(const torch::autograd::Variable& tensor,
                      const Device& device)
@@ -317,11 +1569,8 @@ XLATensor::XLATensor(std::shared_ptr<xla::ComputationClient::Data> xla_data,
                                    DeviceFromString(xla_data->device()))),
       requires_grad_(requires_grad) {}
 
-XLATensor::XLATensor(std::shared_ptr<XlaGraphNode> xla_graph_node,
-                     const Device& device)
-    : data_(std::make_shared<Data>(std::move(xla_graph_node), device)) {
-  TryLimitGraphSize();
-}
+XLATensor::XLATensor(ir::NodePtr ir_node, const Device& device)
+    : data_(std::make_shared<Data>(std::move(ir_node), device)) {}
 
 std::shared_ptr<XLATensor> XLATensor::grad() const { return data_->grad; }
 
@@ -334,20 +1583,12 @@ void XLATensor::SetGradient(std::shared_ptr<XLATensor> grad) {
 }
 
 at::ScalarType XLATensor::dtype() const {
-  xla::PrimitiveType xla_type = shape().element_type();
-  switch (xla_type) {
-    case xla::PrimitiveType::F32:
-      return at::ScalarType::Float;
-    case xla::PrimitiveType::S64:
-      return at::ScalarType::Long;
-    default:
-      TF_LOG(FATAL) << "XLA type not supported: " << xla_type;
-  }
+  return TensorTypeFromXlaType(shape().element_type());
 }
 
 const xla::Shape& XLATensor::shape() const {
   return data_->xla_data ? data_->xla_data->shape()
-                         : data_->xla_graph_node->shape();
+                         : data_->ir_node->shape();
 }
 
 const XLATensor::Device& XLATensor::GetDevice() const { return data_->device; }
@@ -356,6 +1597,12 @@ xla::int64 XLATensor::GetUniqueId() const { return data_->unique_id; }
 
 const std::shared_ptr<xla::ComputationClient::Data>& XLATensor::GetXlaData() {
   ApplyPendingGraph();
+  const AsyncXlaData* async_data =
+      dynamic_cast<const AsyncXlaData*>(data_->xla_data.get());
+  if (async_data != nullptr) {
+    data_->xla_data = async_data->Get();
+    TensorsArena::Get()->DataChanged(this);
+  }
   return data_->xla_data;
 }
 
@@ -366,11 +1613,11 @@ const std::shared_ptr<xla::ComputationClient::Data>& XLATensor::CurrentXlaData()
 
 std::string XLATensor::DumpGraphNodeComputation() const {
   std::string hlo_text;
-  auto& xla_graph_node = CurrentXlaGraphNode();
-  if (xla_graph_node != nullptr) {
-    XlaGraphContext xla_graph_ctx(/*collate_parameters=*/true);
-    auto root = xla_graph_node->Generate(&xla_graph_ctx);
-    auto computation = xla_graph_ctx.Build(root).ConsumeValueOrDie();
+  auto& ir_node = CurrentIrNode();
+  if (ir_node != nullptr) {
+    ir::LoweringContext lowering_ctx("DumpGraphNodeComputation");
+    xla::XlaOp root = lowering_ctx.GetOutputOp(ir::Output(ir_node.get()));
+    auto computation = lowering_ctx.Build(root).ConsumeValueOrDie();
     hlo_text =
         xla::xrt_util::GetComputationHloText(computation).ConsumeValueOrDie();
   }
@@ -383,31 +1630,51 @@ void XLATensor::SetXlaData(
       << shape() << " vs " << xla_data->shape() << "\n"
       << DumpGraphNodeComputation();
   data_->xla_data = std::move(xla_data);
-  data_->xla_graph_node = nullptr;
+  TensorsArena::Get()->DataChanged(this);
+  if (data_->ir_node != nullptr) {
+    data_->ir_node = nullptr;
+    TensorsArena::Get()->ClearPending(this);
+  }
 }
 
-void XLATensor::SetXlaGraphNode(std::shared_ptr<XlaGraphNode> xla_graph_node) {
-  data_->xla_graph_node = std::move(xla_graph_node);
+void XLATensor::SetIrNode(ir::NodePtr ir_node) {
+  bool was_pending = data_->ir_node != nullptr;
+  data_->ir_node = std::move(ir_node);
+  if (!was_pending) {
+    TensorsArena::Get()->MarkPending(this);
+  }
   TryLimitGraphSize();
 }
 
 void XLATensor::TryLimitGraphSize() {
-  // If we are accumulating too many nodes in the pending graph, render the XLA
-  // by executing the pending graph.
-  static const xla::int64 kMaxPendingGraphSize = 1000;
-  if (data_->xla_graph_node != nullptr &&
-      data_->xla_graph_node->graph_size() > kMaxPendingGraphSize) {
+  const ir::NodePtr& ir_node = data_->ir_node;
+  if (ir_node == nullptr || !ExceedsGraphCutPolicy(*ir_node)) {
+    return;
+  }
+  ir_node->RefreshGraphStats();
+  if (!ExceedsGraphCutPolicy(*ir_node)) {
+    return;
+  }
+  // Cutting only this tensor graph would leave the other pending graphs
+  // growing, and the next cut would land at a different position, generating
+  // a new computation every time. Applying all the pending tensors of the
+  // device resets all the graphs, so the cuts repeat at the same positions
+  // within the training loop iterations.
+  XLA_COUNTER("GraphCuts", 1);
+  ApplyPendingGraph(GetPendingTensors(&data_->device),
+                    /*apply_context=*/nullptr);
+  if (data_->ir_node != nullptr) {
+    // Tensors built with the direct constructors are not tracked by the arena.
     ApplyPendingGraph();
   }
 }
 
-std::shared_ptr<XlaGraphNode> XLATensor::GetXlaGraphNode() const {
-  return data_->xla_graph_node ? data_->xla_graph_node
-                               : CreateTensorNode(data_->xla_data);
+ir::NodePtr XLATensor::GetIrNode() const {
+  return data_->ir_node ? data_->ir_node : CreateTensorNode(data_->xla_data);
 }
 
-const std::shared_ptr<XlaGraphNode>& XLATensor::CurrentXlaGraphNode() const {
-  return data_->xla_graph_node;
+const ir::NodePtr& XLATensor::CurrentIrNode() const {
+  return data_->ir_node;
 }
 
 void XLATensor::ReferenceDataFrom(const XLATensor& source) {
@@ -415,8 +1682,15 @@ void XLATensor::ReferenceDataFrom(const XLATensor& source) {
   XLA_CHECK(xla::ShapeUtil::Equal(shape(), source.shape()))
       << shape() << " vs " << source.shape();
 
+  bool was_pending = data_->ir_node != nullptr;
   data_->xla_data = source.data_->xla_data;
-  data_->xla_graph_node = source.data_->xla_graph_node;
+  data_->ir_node = source.data_->ir_node;
+  TensorsArena::Get()->DataChanged(this);
+  if (data_->ir_node != nullptr && !was_pending) {
+    TensorsArena::Get()->MarkPending(this);
+  } else if (data_->ir_node == nullptr && was_pending) {
+    TensorsArena::Get()->ClearPending(this);
+  }
 }
 
 std::vector<int64_t> XLATensor::Size() const {
@@ -426,70 +1700,245 @@ std::vector<int64_t> XLATensor::Size() const {
 }
 
 at::Tensor XLATensor::toTensor() {
-  ApplyPendingGraph();
-
-  std::vector<xla::Literal> literals =
-      XlaGetClient()->TransferFromServer({GetXlaData()});
-  return torch::autograd::make_variable(
-      MakeTensorFromXlaLiteral(literals.front()), RequiresGrad());
+  at::Tensor tensor;
+  xla::Literal literal;
+  if (RunPendingGraph(&literal)) {
+    tensor = MakeTensorFromXlaLiteral(literal);
+  } else {
+    tensor = std::move(FetchTensors({GetXlaData()}).front());
+  }
+  return torch::autograd::make_variable(tensor, RequiresGrad());
 }
 
 std::vector<std::shared_ptr<XLATensor>> XLATensor::GetLiveTensors() {
   return TensorsArena::Get()->GetTensors();
 }
 
+std::vector<std::shared_ptr<XLATensor>> XLATensor::GetPendingTensors(
+    const Device* device) {
+  return TensorsArena::Get()->GetPendingTensors(device);
+}
+
 std::vector<at::Tensor> XLATensor::GetTensors(
     const std::vector<std::shared_ptr<XLATensor>>& tensors) {
-  // TODO(dlibenzi): We do apply/compute and then fetch. Changing the API to
-  // support getting handles and data might save a few pennies here.
-  ApplyPendingGraph(tensors, /*apply_context=*/nullptr);
+  // The tensors with a pending graph get their values fetched within the same
+  // execution which computes them, while the others are fetched separately.
+  std::vector<bool> pending(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    pending[i] = tensors[i]->CurrentIrNode() != nullptr;
+  }
+  std::vector<xla::Literal> literals(tensors.size());
+  RunApply(tensors, /*apply_context=*/nullptr, &literals);
 
+  std::vector<at::Tensor> results(tensors.size());
   std::vector<std::shared_ptr<xla::ComputationClient::Data>> tensors_data;
-  for (auto& tensor : tensors) {
-    tensors_data.push_back(tensor->GetXlaData());
+  std::vector<size_t> fetch_indices;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    if (pending[i]) {
+      results[i] = MakeTensorFromXlaLiteral(literals[i]);
+    } else {
+      tensors_data.push_back(tensors[i]->GetXlaData());
+      fetch_indices.push_back(i);
+    }
+  }
+  if (!tensors_data.empty()) {
+    std::vector<at::Tensor> fetched_tensors = FetchTensors(tensors_data);
+    for (size_t i = 0; i < fetch_indices.size(); ++i) {
+      results[fetch_indices[i]] = std::move(fetched_tensors[i]);
+    }
   }
-  std::vector<xla::Literal> literals =
-      XlaGetClient()->TransferFromServer(tensors_data);
-  std::vector<at::Tensor> results;
-  for (size_t i = 0; i < literals.size(); ++i) {
-    results.push_back(torch::autograd::make_variable(
-        MakeTensorFromXlaLiteral(literals[i]), tensors[i]->RequiresGrad()));
+  for (size_t i = 0; i < results.size(); ++i) {
+    results[i] = torch::autograd::make_variable(results[i],
+                                                tensors[i]->RequiresGrad());
   }
   return results;
 }
 
+std::vector<at::Tensor> XLATensor::TensorsFetch::Wait() {
+  XLA_CHECK_OK(mwait_.Wait());
+  return results_;
+}
+
+std::shared_ptr<XLATensor::TensorsFetch> XLATensor::GetTensorsAsync(
+    const std::vector<std::shared_ptr<XLATensor>>& tensors) {
+  std::vector<std::shared_ptr<XLATensor>> pending_tensors;
+  for (auto& tensor : tensors) {
+    if (tensor->CurrentIrNode() != nullptr) {
+      pending_tensors.push_back(tensor);
+    }
+  }
+  if (!pending_tensors.empty()) {
+    RunAsyncApply(pending_tensors, /*apply_context=*/nullptr);
+  }
+  // The fetch holds references to the current device data (or to the
+  // placeholders of the background apply), so that it is not affected by the
+  // tensors being updated in the meantime.
+  std::vector<std::shared_ptr<xla::ComputationClient::Data>> tensors_data;
+  std::vector<bool> requires_grad;
+  for (auto& tensor : tensors) {
+    XLA_CHECK(tensor->CurrentXlaData() != nullptr);
+    tensors_data.push_back(tensor->CurrentXlaData());
+    requires_grad.push_back(tensor->RequiresGrad());
+  }
+  XLA_COUNTER("AsyncFetchTensors", 1);
+
+  auto fetch = std::make_shared<TensorsFetch>();
+  auto fetch_fn = [fetch, tensors_data, requires_grad]() mutable {
+    for (auto& data : tensors_data) {
+      const AsyncXlaData* async_data =
+          dynamic_cast<const AsyncXlaData*>(data.get());
+      if (async_data != nullptr) {
+        data = async_data->Get();
+      }
+    }
+    std::vector<at::Tensor> results = FetchTensors(tensors_data);
+    for (size_t i = 0; i < results.size(); ++i) {
+      results[i] = torch::autograd::make_variable(results[i], requires_grad[i]);
+    }
+    fetch->results_ = std::move(results);
+  };
+  // The fetch is marked ready, failed or not, before the completer signals
+  // the waiters, so that IsReady() holds as soon as Wait() returns.
+  auto ready_fn = [fetch, fetch_fn]() mutable {
+    try {
+      fetch_fn();
+    } catch (...) {
+      fetch->ready_ = true;
+      throw;
+    }
+    fetch->ready_ = true;
+  };
+  xla::xla_env::ScheduleIoClosure(
+      fetch->mwait_.Completer(std::move(ready_fn)));
+  return fetch;
+}
+
 std::vector<std::shared_ptr<XLATensor>> XLATensor::CreateTensors(
     const std::vector<torch::autograd::Variable>& tensors,
-    const std::vector<std::string>& devices) {
+    const std::vector<std::string>& devices,
+    const std::vector<c10::optional<DeviceCast>>* device_casts) {
   XLA_CHECK_EQ(tensors.size(), devices.size());
-  std::vector<xla::ComputationClient::LiteralDevice> literal_device;
+  XLA_CHECK(device_casts == nullptr || device_casts->size() == tensors.size());
+  std::vector<xla::ComputationClient::TensorSource> source_tensors;
   for (size_t i = 0; i < tensors.size(); ++i) {
-    auto converter = [&, i]() -> xla::Literal {
-      Device device = DeviceFromString(devices[i]);
-      xla::Shape shape = MakeArrayShapeFromDimensions(
-          tensors[i].sizes(),
-          XlaHelpers::MakeXlaPrimitiveType(tensors[i].type().scalarType()),
-          device.hw_type);
-      return GetTensorLiteral(tensors[i], &shape);
-    };
-    literal_device.emplace_back(std::move(converter), devices[i]);
+    Device device = DeviceFromString(devices[i]);
+    xla::Shape shape = MakeArrayShapeFromDimensions(
+        tensors[i].sizes(),
+        XlaHelpers::MakeXlaPrimitiveType(tensors[i].type().scalarType()),
+        device.hw_type);
+    auto populate_fn =
+        [&, i](const xla::ComputationClient::TensorSource& source_tensor,
+               void* dest_buffer, size_t dest_buffer_size) {
+          PopulateTensorBuffer(tensors[i], source_tensor.shape, dest_buffer,
+                               dest_buffer_size);
+        };
+    source_tensors.emplace_back(std::move(shape), devices[i],
+                                std::move(populate_fn));
   }
-  auto handles = XlaGetClient()->TransferToServer(literal_device);
+  auto handles = XlaGetClient()->TransferTensorsToServer(source_tensors);
+  std::vector<std::shared_ptr<XLATensor>> xla_tensors;
+  for (size_t i = 0; i < handles.size(); ++i) {
+    if (device_casts != nullptr && (*device_casts)[i]) {
+      xla_tensors.push_back(CreateDeviceCastTensor(
+          std::move(handles[i]), *(*device_casts)[i],
+          tensors[i].requires_grad()));
+    } else {
+      xla_tensors.push_back(
+          Create(std::move(handles[i]), tensors[i].requires_grad()));
+    }
+  }
+  return xla_tensors;
+}
+
+std::vector<std::vector<std::shared_ptr<XLATensor>>>
+XLATensor::BroadcastTensors(
+    const std::vector<torch::autograd::Variable>& tensors,
+    const std::vector<Device>& devices) {
+  XLA_CHECK(!devices.empty());
+  std::vector<std::string> device_strings;
+  for (auto& device : devices) {
+    XLA_CHECK(device.hw_type == devices.front().hw_type)
+        << "Cannot broadcast to devices of different types: " << device
+        << " vs " << devices.front();
+    device_strings.push_back(device.ToString());
+  }
+  std::vector<xla::ComputationClient::TensorSource> source_tensors;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    xla::Shape shape = MakeArrayShapeFromDimensions(
+        tensors[i].sizes(),
+        XlaHelpers::MakeXlaPrimitiveType(tensors[i].type().scalarType()),
+        devices.front().hw_type);
+    auto populate_fn =
+        [&, i](const xla::ComputationClient::TensorSource& source_tensor,
+               void* dest_buffer, size_t dest_buffer_size) {
+          PopulateTensorBuffer(tensors[i], source_tensor.shape, dest_buffer,
+                               dest_buffer_size);
+        };
+    source_tensors.emplace_back(std::move(shape), device_strings.front(),
+                                std::move(populate_fn));
+  }
+  auto handles =
+      XlaGetClient()->BroadcastTensorsToServer(source_tensors, device_strings);
+  std::vector<std::vector<std::shared_ptr<XLATensor>>> xla_tensors;
+  for (size_t i = 0; i < handles.size(); ++i) {
+    std::vector<std::shared_ptr<XLATensor>> device_tensors;
+    for (auto& handle : handles[i]) {
+      device_tensors.push_back(
+          Create(std::move(handle), tensors[i].requires_grad()));
+    }
+    xla_tensors.push_back(std::move(device_tensors));
+  }
+  return xla_tensors;
+}
+
+std::vector<std::shared_ptr<XLATensor>> XLATensor::TransferTensors(
+    const std::vector<std::shared_ptr<XLATensor>>& tensors,
+    const std::vector<Device>& devices) {
+  XLA_CHECK_EQ(tensors.size(), devices.size());
+  ApplyPendingGraph(tensors, /*apply_context=*/nullptr);
+  std::vector<std::shared_ptr<xla::ComputationClient::Data>> handles;
+  std::vector<std::string> device_strings;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    handles.push_back(tensors[i]->GetXlaData());
+    device_strings.push_back(devices[i].ToString());
+  }
+  handles = XlaGetClient()->TransferBetweenDevices(handles, device_strings);
   std::vector<std::shared_ptr<XLATensor>> xla_tensors;
   for (size_t i = 0; i < handles.size(); ++i) {
     xla_tensors.push_back(
-        Create(std::move(handles[i]), tensors[i].requires_grad()));
+        Create(std::move(handles[i]), tensors[i]->RequiresGrad()));
   }
   return xla_tensors;
 }
 
-std::shared_ptr<XlaGraphNode> XLATensor::CreateTensorNode(
+std::shared_ptr<XLATensor> XLATensor::CreateDeviceCastTensor(
+    std::shared_ptr<xla::ComputationClient::Data> data,
+    const DeviceCast& device_cast, bool requires_grad) {
+  XLA_COUNTER("DeviceCastTensors", 1);
+  Device device = DeviceFromString(data->device());
+  xla::PrimitiveType type =
+      XlaHelpers::MakeXlaPrimitiveType(device_cast.type);
+  ir::NodePtr ir_node = CreateTensorNode(std::move(data));
+  if (ir_node->shape().element_type() != type) {
+    ir_node = std::make_shared<ir::ops::Cast>(ir_node, type);
+  }
+  if (device_cast.scale != 1.0) {
+    ir_node = std::make_shared<ir::ops::Mul>(
+        ir_node, std::make_shared<ir::ops::Scalar>(device_cast.scale, type));
+  }
+  if (device_cast.offset != 0.0) {
+    ir_node = std::make_shared<ir::ops::Add>(
+        ir_node, std::make_shared<ir::ops::Scalar>(device_cast.offset, type),
+        std::make_shared<ir::ops::Scalar>(1.0, type));
+  }
+  std::shared_ptr<XLATensor> tensor = Create(std::move(ir_node), device);
+  tensor->requires_grad_ = requires_grad;
+  return tensor;
+}
+
+ir::NodePtr XLATensor::CreateTensorNode(
     std::shared_ptr<xla::ComputationClient::Data> data) {
-  auto generator = [data](XlaGraphContext* ctx,
-                          const XlaGraphNode&) -> xla::XlaOp {
-    return ctx->GetParameter(data);
-  };
-  return XlaGraphNode::New(std::move(generator), data->shape(), {});
+  return std::make_shared<ir::ops::DeviceData>(std::move(data));
 }
 
 xla::int64 XLATensor::GetNextTensorId() {
@@ -497,69 +1946,38 @@ xla::int64 XLATensor::GetNextTensorId() {
   return id_generator->fetch_add(1);
 }
 
-std::shared_ptr<XlaGraphNode> XLATensor::CreateMulNode(const XLATensor& other) {
-  auto generator = [](XlaGraphContext* ctx,
-                      const XlaGraphNode& node) -> xla::XlaOp {
-    auto node_op = node.input(0)->Generate(ctx);
-    auto other_node_op = node.input(1)->Generate(ctx);
-    return XlaHelpers::PromotedMul(node_op, other_node_op);
-  };
-  return XlaGraphNode::New(std::move(generator),
-                           XlaHelpers::GetPromotedShape(shape(), other.shape()),
-                           {GetXlaGraphNode(), other.GetXlaGraphNode()});
-}
-
-std::shared_ptr<XlaGraphNode> XLATensor::CreateMulNode(
-    const at::Scalar& other) {
-  auto generator = [other](XlaGraphContext* ctx,
-                           const XlaGraphNode& node) -> xla::XlaOp {
-    auto node_op = node.input(0)->Generate(ctx);
-    return node_op * XlaHelpers::ScalarValue<float>(
-                         other.toDouble(), XlaHelpers::TypeOfXlaOp(node_op),
-                         ctx->builder());
-  };
-  return XlaGraphNode::New(std::move(generator), shape(), {GetXlaGraphNode()});
+ir::NodePtr XLATensor::CreateScalarNode(const at::Scalar& value,
+                                        xla::PrimitiveType type) const {
+  if (ScalarsAsParameters()) {
+    return CreateTensorNode(
+        GetScalarData(value.toDouble(), type, GetDevice().ToString()));
+  }
+  return std::make_shared<ir::ops::Scalar>(value.toDouble(), type);
 }
 
-std::shared_ptr<XlaGraphNode> XLATensor::CreateDivNode(const XLATensor& other) {
-  auto generator = [](XlaGraphContext* ctx,
-                      const XlaGraphNode& node) -> xla::XlaOp {
-    auto node_op = node.input(0)->Generate(ctx);
-    auto other_node_op = node.input(1)->Generate(ctx);
-    return XlaHelpers::PromotedDiv(node_op, other_node_op);
-  };
-  return XlaGraphNode::New(std::move(generator),
-                           XlaHelpers::GetPromotedShape(shape(), other.shape()),
-                           {GetXlaGraphNode(), other.GetXlaGraphNode()});
-}
-
-std::shared_ptr<XlaGraphNode> XLATensor::CreateDivNode(
-    const at::Scalar& other) {
-  auto generator = [other](XlaGraphContext* ctx,
-                           const XlaGraphNode& node) -> xla::XlaOp {
-    auto node_op = node.input(0)->Generate(ctx);
-    return node_op / XlaHelpers::ScalarValue<float>(
-                         other.toDouble(), XlaHelpers::TypeOfXlaOp(node_op),
-                         ctx->builder());
-  };
-  return XlaGraphNode::New(std::move(generator), shape(), {GetXlaGraphNode()});
-}
-
-std::shared_ptr<XlaGraphNode> XLATensor::CreateAddNode(
-    const XLATensor& other, const at::Scalar& alpha) {
-  auto generator = [alpha](XlaGraphContext* ctx,
-                           const XlaGraphNode& node) -> xla::XlaOp {
-    auto node_op = node.input(0)->Generate(ctx);
-    auto other_node_op = node.input(1)->Generate(ctx);
-    return XlaHelpers::PromotedAdd(
-        node_op, other_node_op * XlaHelpers::ScalarValue<float>(
-                                     alpha.toDouble(),
-                                     XlaHelpers::TypeOfXlaOp(other_node_op),
-                                     ctx->builder()));
-  };
-  return XlaGraphNode::New(std::move(generator),
-                           XlaHelpers::GetPromotedShape(shape(), other.shape()),
-                           {GetXlaGraphNode(), other.GetXlaGraphNode()});
+ir::NodePtr XLATensor::CreateMulNode(const XLATensor& other) {
+  return std::make_shared<ir::ops::Mul>(GetIrNode(), other.GetIrNode());
+}
+
+ir::NodePtr XLATensor::CreateMulNode(const at::Scalar& other) {
+  return std::make_shared<ir::ops::Mul>(
+      GetIrNode(), CreateScalarNode(other, shape().element_type()));
+}
+
+ir::NodePtr XLATensor::CreateDivNode(const XLATensor& other) {
+  return std::make_shared<ir::ops::Div>(GetIrNode(), other.GetIrNode());
+}
+
+ir::NodePtr XLATensor::CreateDivNode(const at::Scalar& other) {
+  return std::make_shared<ir::ops::Div>(
+      GetIrNode(), CreateScalarNode(other, shape().element_type()));
+}
+
+ir::NodePtr XLATensor::CreateAddNode(const XLATensor& other,
+                                     const at::Scalar& alpha) {
+  return std::make_shared<ir::ops::Add>(
+      GetIrNode(), other.GetIrNode(),
+      CreateScalarNode(alpha, other.shape().element_type()));
 }
 
 std::shared_ptr<XLATensor> XLATensor::add(const XLATensor& other,
@@ -568,7 +1986,7 @@ std::shared_ptr<XLATensor> XLATensor::add(const XLATensor& other,
 }
 
 void XLATensor::add_(const XLATensor& other, const at::Scalar& alpha) {
-  SetXlaGraphNode(CreateAddNode(other, alpha));
+  SetIrNode(CreateAddNode(other, alpha));
 }
 
 std::shared_ptr<XLATensor> XLATensor::mul(const XLATensor& other) {
@@ -580,11 +1998,11 @@ std::shared_ptr<XLATensor> XLATensor::mul(const at::Scalar& other) {
 }
 
 void XLATensor::mul_(const XLATensor& other) {
-  SetXlaGraphNode(CreateMulNode(other));
+  SetIrNode(CreateMulNode(other));
 }
 
 void XLATensor::mul_(const at::Scalar& other) {
-  SetXlaGraphNode(CreateMulNode(other));
+  SetIrNode(CreateMulNode(other));
 }
 
 std::shared_ptr<XLATensor> XLATensor::div(const XLATensor& other) {
@@ -596,106 +2014,96 @@ std::shared_ptr<XLATensor> XLATensor::div(const at::Scalar& other) {
 }
 
 void XLATensor::div_(const XLATensor& other) {
-  SetXlaGraphNode(CreateDivNode(other));
+  SetIrNode(CreateDivNode(other));
 }
 
 void XLATensor::div_(const at::Scalar& other) {
-  SetXlaGraphNode(CreateDivNode(other));
+  SetIrNode(CreateDivNode(other));
 }
 
 void XLATensor::zero_() {
-  xla::Shape tensor_shape = shape();
-  auto generator = [tensor_shape](XlaGraphContext* ctx,
-                                  const XlaGraphNode&) -> xla::XlaOp {
-    auto zero_literal = xla::LiteralUtil::Zero(tensor_shape.element_type());
-    auto const_zero = xla::ConstantLiteral(ctx->builder(), zero_literal);
-    return xla::Broadcast(const_zero, XlaHelpers::ShapeSizes(tensor_shape));
-  };
-  SetXlaGraphNode(XlaGraphNode::New(std::move(generator), tensor_shape, {}));
+  SetIrNode(std::make_shared<ir::ops::Zeros>(shape()));
 }
 
 void XLATensor::addcdiv_(const at::Scalar& value, const XLATensor& tensor1,
                          const XLATensor& tensor2) {
-  auto generator = [value](XlaGraphContext* ctx,
-                           const XlaGraphNode& node) -> xla::XlaOp {
-    auto node_op = node.input(0)->Generate(ctx);
-    auto tensor1_node_op = node.input(1)->Generate(ctx);
-    auto tensor2_node_op = node.input(2)->Generate(ctx);
-    auto div_op = XlaHelpers::PromotedDiv(tensor1_node_op, tensor2_node_op);
-    auto scaled_op =
-        div_op * XlaHelpers::ScalarValue<float>(value.toDouble(),
-                                                XlaHelpers::TypeOfXlaOp(div_op),
-                                                ctx->builder());
-    return XlaHelpers::PromotedAdd(node_op, scaled_op);
-  };
   xla::Shape div_shape =
       XlaHelpers::GetPromotedShape(tensor1.shape(), tensor2.shape());
-  SetXlaGraphNode(XlaGraphNode::New(
-      std::move(generator), XlaHelpers::GetPromotedShape(shape(), div_shape),
-      {GetXlaGraphNode(), tensor1.GetXlaGraphNode(),
-       tensor2.GetXlaGraphNode()}));
+  SetIrNode(std::make_shared<ir::ops::Addcdiv>(
+      GetIrNode(), tensor1.GetIrNode(), tensor2.GetIrNode(),
+      CreateScalarNode(value, div_shape.element_type())));
 }
 
 void XLATensor::addcmul_(const at::Scalar& value, const XLATensor& tensor1,
                          const XLATensor& tensor2) {
-  auto generator = [value](XlaGraphContext* ctx,
-                           const XlaGraphNode& node) -> xla::XlaOp {
-    auto node_op = node.input(0)->Generate(ctx);
-    auto tensor1_node_op = node.input(1)->Generate(ctx);
-    auto tensor2_node_op = node.input(2)->Generate(ctx);
-    auto mul_op = XlaHelpers::PromotedMul(tensor1_node_op, tensor2_node_op);
-    auto scaled_op =
-        mul_op * XlaHelpers::ScalarValue<float>(value.toDouble(),
-                                                XlaHelpers::TypeOfXlaOp(mul_op),
-                                                ctx->builder());
-    return XlaHelpers::PromotedAdd(node_op, scaled_op);
-  };
   xla::Shape mul_shape =
       XlaHelpers::GetPromotedShape(tensor1.shape(), tensor2.shape());
-  SetXlaGraphNode(XlaGraphNode::New(
-      std::move(generator), XlaHelpers::GetPromotedShape(shape(), mul_shape),
-      {GetXlaGraphNode(), tensor1.GetXlaGraphNode(),
-       tensor2.GetXlaGraphNode()}));
+  SetIrNode(std::make_shared<ir::ops::Addcmul>(
+      GetIrNode(), tensor1.GetIrNode(), tensor2.GetIrNode(),
+      CreateScalarNode(value, mul_shape.element_type())));
 }
 
 std::shared_ptr<XLATensor> XLATensor::cross_replica_sum(
     const std::vector<std::vector<xla::int64>>& groups) {
-  auto generator = [groups](XlaGraphContext* ctx,
-                            const XlaGraphNode& node) -> xla::XlaOp {
-    std::vector<xla::ReplicaGroup> crs_groups;
-    for (auto& group : groups) {
-      xla::ReplicaGroup rgroup;
-      for (auto replica_id : group) {
-        rgroup.add_replica_ids(replica_id);
-      }
-      crs_groups.push_back(std::move(rgroup));
-    }
-    auto node_op = node.input(0)->Generate(ctx);
-    return xla::CrossReplicaSum(node_op, crs_groups);
-  };
   auto crs_node =
-      XlaGraphNode::New(std::move(generator), shape(), {GetXlaGraphNode()});
+      std::make_shared<ir::ops::CrossReplicaSum>(GetIrNode(), groups);
   return Create(std::move(crs_node), data_->device);
 }
 
-void XLATensor::ApplyPendingGraph() {
-  auto& xla_graph_node = CurrentXlaGraphNode();
-  if (xla_graph_node != nullptr) {
-    XlaGraphContext xla_graph_ctx(/*collate_parameters=*/true);
-    auto root = xla_graph_node->Generate(&xla_graph_ctx);
+void XLATensor::ApplyPendingGraph() { RunPendingGraph(/*literal=*/nullptr); }
+
+bool XLATensor::RunPendingGraph(xla::Literal* literal) {
+  auto& ir_node = CurrentIrNode();
+  if (ir_node == nullptr) {
+    return false;
+  }
+  std::string device = GetDevice().ToString();
+  ir::GraphFingerprint fingerprint =
+      ir::ComputeGraphFingerprint({ir_node.get()});
+  tensorflow::Fprint128 cache_key =
+      GetApplyCacheKey(fingerprint, device, /*tuple_result=*/false,
+                       /*donation_hash=*/0);
+  std::shared_ptr<CachedApplyComputation> cached_computation =
+      FindApplyComputation(cache_key, fingerprint, {&ir_node->shape()});
+  std::vector<xla::ComputationClient::Data*> parameters_data;
+  if (cached_computation != nullptr) {
+    parameters_data = GetMappedParameters(
+        fingerprint, cached_computation->parameters_mapping);
+  } else {
+    ir::LoweringContext lowering_ctx("ApplyPendingGraph");
+    xla::XlaOp root = lowering_ctx.GetOutputOp(ir::Output(ir_node.get()));
     xla::XlaComputation computation =
-        xla_graph_ctx.Build(root).ConsumeValueOrDie();
-    auto compiled_computation = XlaGetClient()->Compile(
-        std::move(computation), {GetDevice().ToString()},
-        /*output_shape=*/nullptr);
+        lowering_ctx.Build(root).ConsumeValueOrDie();
+    parameters_data = lowering_ctx.GetParametersData();
+    cached_computation = std::make_shared<CachedApplyComputation>(
+        XlaGetClient()->Compile(std::move(computation), {device},
+                                /*output_shape=*/nullptr),
+        GetParametersMapping(fingerprint, parameters_data));
+    GetApplyComputationCache()->Add(cache_key, cached_computation);
+  }
+  ResolveParameters(&parameters_data);
+  const auto& compiled_computation = cached_computation->computation;
+  std::vector<std::shared_ptr<xla::ComputationClient::Data>> results;
+  if (literal != nullptr) {
+    xla::ComputationClient::ExecuteParallelOptions options;
+    options.explode_tuple = false;
+    std::vector<std::vector<xla::Literal>> literals;
+    auto parallel_results = XlaGetClient()->ExecuteParallelAndFetch(
+        {compiled_computation.get()}, {parameters_data},
+        {compiled_computation->devices()[0]}, {{0}}, &literals, options);
+    XLA_CHECK_EQ(literals.front().size(), 1);
+    *literal = std::move(literals.front().front());
+    results = std::move(parallel_results.front());
+  } else {
     xla::ComputationClient::ExecuteComputationOptions options;
     options.explode_tuple = false;
-    auto results = XlaGetClient()->ExecuteComputation(
-        *compiled_computation, xla_graph_ctx.GetParametersData(),
+    results = XlaGetClient()->ExecuteComputation(
+        *compiled_computation, parameters_data,
         compiled_computation->devices()[0], options);
-    XLA_CHECK_EQ(results.size(), 1);
-    SetXlaData(results.front());
   }
+  XLA_CHECK_EQ(results.size(), 1);
+  SetXlaData(results.front());
+  return true;
 }
 
 std::vector<size_t> XLATensor::GetApplyOrder(
@@ -703,7 +2111,7 @@ std::vector<size_t> XLATensor::GetApplyOrder(
   std::vector<size_t> order;
   order.reserve(tensors.size());
   for (size_t i = 0; i < tensors.size(); ++i) {
-    if (tensors[i]->CurrentXlaGraphNode() != nullptr) {
+    if (tensors[i]->CurrentIrNode() != nullptr) {
       // Add only tensors which need to be synced.
       order.push_back(i);
     }
@@ -722,101 +2130,258 @@ std::vector<size_t> XLATensor::GetApplyOrder(
   return order;
 }
 
-bool XLATensor::RunCachedApply(
+bool XLATensor::PrepareCachedApply(
     const std::vector<std::shared_ptr<XLATensor>>& tensors,
-    const ApplyContext& apply_context) {
-  // Within the ApplyContext we saved the tensors unique IDs, and here we have
-  // to map back the unique IDs to the tensor indices within the tensors vector.
-  std::unordered_map<xla::int64, size_t> uid_index_map(tensors.size());
-  for (size_t i = 0; i < tensors.size(); ++i) {
+    ApplyContext* apply_context, CachedApplyRun* run) {
+  std::vector<size_t> order = GetApplyOrder(tensors);
+  std::vector<xla::int64> uid_order;
+  uid_order.reserve(order.size());
+  for (auto i : order) {
+    uid_order.push_back(tensors[i]->GetUniqueId());
+  }
+  const ApplyContext::Entry* apply_entry = FindApplyContextEntry(
+      apply_context, GetUidOrderHash(uid_order), uid_order);
+  if (apply_entry == nullptr) {
+    return false;
+  }
+  // The computations results overwrite the tensors with a pending graph, whose
+  // indices are found by unique ID within the tensors vector.
+  std::unordered_map<xla::int64, size_t> uid_index_map(order.size());
+  for (auto i : order) {
     uid_index_map[tensors[i]->GetUniqueId()] = i;
   }
-  std::vector<std::vector<xla::ComputationClient::Data*>> parameters;
-  parameters.reserve(apply_context.devices.size());
-  for (auto& device_input_mapping : apply_context.input_mapping) {
-    std::vector<xla::ComputationClient::Data*> device_parameters;
-    device_parameters.reserve(device_input_mapping.size());
-    for (auto uid : device_input_mapping) {
+  run->index_mapping.reserve(apply_entry->index_mapping.size());
+  for (auto& computation_index_mapping : apply_entry->index_mapping) {
+    std::vector<size_t> current_index_mapping;
+    current_index_mapping.reserve(computation_index_mapping.size());
+    for (auto uid : computation_index_mapping) {
       auto it = uid_index_map.find(uid);
-      if (it != uid_index_map.end()) {
-        auto& xla_data = tensors[it->second]->CurrentXlaData();
-        if (xla_data == nullptr) {
-          // If we do not find real device data (we have a cached graph instead)
-          // at the given tensor, it means the cached information does not apply
-          // anymore.
-          return false;
-        }
-        device_parameters.push_back(xla_data.get());
-      } else {
-        // If we have not found the unique ID of the parameter which is supposed
-        // to feed data to the computation, the pending graph context changed,
-        // and the apply_context is no more valid.
+      if (it == uid_index_map.end()) {
         return false;
       }
+      current_index_mapping.push_back(it->second);
     }
-    parameters.push_back(std::move(device_parameters));
+    run->index_mapping.push_back(std::move(current_index_mapping));
   }
-  std::vector<std::vector<size_t>> index_mapping;
-  index_mapping.reserve(apply_context.devices.size());
-  for (auto& computation_index_mapping : apply_context.index_mapping) {
-    std::vector<size_t> current_index_mapping;
-    current_index_mapping.reserve(computation_index_mapping.size());
-    for (auto uid : computation_index_mapping) {
-      auto it = uid_index_map.find(uid);
-      if (it != uid_index_map.end()) {
-        current_index_mapping.push_back(it->second);
-      } else {
+  // The parameters are fed with the current device data of the tensors whose
+  // unique IDs have been saved within the apply context, which the tensors
+  // arena tracks, so there is no need to walk all the live tensors.
+  // The scalar parameters are gathered from the current graphs instead, which
+  // is linear in the graphs size, so it is done only if the computation has
+  // any.
+  run->parameters.reserve(apply_entry->input_mapping.size());
+  for (size_t i = 0; i < apply_entry->input_mapping.size(); ++i) {
+    const auto& scalar_parameters = apply_entry->scalar_parameters[i];
+    std::vector<std::shared_ptr<xla::ComputationClient::Data>> scalar_data;
+    if (!scalar_parameters.empty() &&
+        !GetScalarParameters(tensors, run->index_mapping[i],
+                             apply_entry->graph_hashes[i], scalar_parameters,
+                             &scalar_data)) {
+      return false;
+    }
+    std::vector<std::shared_ptr<XLATensor>> input_tensors =
+        TensorsArena::Get()->GetUidTensors(apply_entry->input_mapping[i]);
+    std::vector<std::shared_ptr<xla::ComputationClient::Data>>
+        device_parameters;
+    device_parameters.reserve(input_tensors.size() + scalar_data.size());
+    size_t scalar_index = 0;
+    for (auto& input_tensor : input_tensors) {
+      while (scalar_index < scalar_parameters.size() &&
+             scalar_parameters[scalar_index].param ==
+                 device_parameters.size()) {
+        device_parameters.push_back(std::move(scalar_data[scalar_index++]));
+      }
+      // If the tensor which is supposed to feed data to the computation is
+      // gone, or has no real device data (we have a cached graph instead), the
+      // pending graph context changed, and the apply entry is no more valid.
+      if (input_tensor == nullptr ||
+          input_tensor->CurrentXlaData() == nullptr) {
+        return false;
+      }
+      device_parameters.push_back(input_tensor->CurrentXlaData());
+    }
+    for (; scalar_index < scalar_data.size(); ++scalar_index) {
+      device_parameters.push_back(std::move(scalar_data[scalar_index]));
+    }
+    run->parameters.push_back(std::move(device_parameters));
+  }
+  run->passthrough_owners.resize(run->parameters.size());
+  if (apply_entry->release_input_handles) {
+    for (size_t i = 0; i < run->parameters.size(); ++i) {
+      // The computations alias their results to the parameters, so they must
+      // not run without taking over the input device data.
+      if (!PlanCachedDonation(run->parameters[i],
+                              apply_entry->parameters_uses[i],
+                              apply_entry->passthrough_params[i],
+                              uid_index_map, &run->passthrough_owners[i])) {
+        XLA_COUNTER("ApplyDonationMiss", 1);
         return false;
       }
     }
-    index_mapping.push_back(std::move(current_index_mapping));
+  }
+  run->release_input_handles = apply_entry->release_input_handles;
+  run->computations = apply_entry->computations;
+  run->devices = apply_entry->devices;
+  return true;
+}
+
+void XLATensor::RunCachedApply(
+    const std::vector<std::shared_ptr<XLATensor>>& tensors,
+    const CachedApplyRun& run) {
+  std::vector<std::vector<xla::ComputationClient::Data*>> parameters;
+  parameters.reserve(run.parameters.size());
+  for (auto& device_parameters : run.parameters) {
+    std::vector<xla::ComputationClient::Data*> device_parameters_data;
+    device_parameters_data.reserve(device_parameters.size());
+    for (auto& data : device_parameters) {
+      device_parameters_data.push_back(ResolveData(data.get()));
+    }
+    parameters.push_back(std::move(device_parameters_data));
   }
 
   xla::ComputationClient::ExecuteParallelOptions options;
+  options.release_input_handles = run.release_input_handles;
+  if (options.release_input_handles) {
+    XLA_COUNTER("DonatedApplyGraph", 1);
+  }
   auto results = XlaGetClient()->ExecuteParallel(
-      xla::util::GetConstSharedPointers(apply_context.computations), parameters,
-      apply_context.devices, options);
+      xla::util::GetConstSharedPointers(run.computations), parameters,
+      run.devices, options);
   size_t device_index = 0;
   for (auto& computation_tuple_elements : results) {
-    SetMulti(tensors, std::move(computation_tuple_elements),
-             index_mapping[device_index]);
+    SetApplyResults(tensors, std::move(computation_tuple_elements),
+                    run.index_mapping[device_index],
+                    run.passthrough_owners[device_index]);
     ++device_index;
   }
-  return true;
 }
 
-XLATensor::DataUidMap XLATensor::CreateDataUidMap(
-    const std::vector<std::shared_ptr<XLATensor>>& tensors) {
-  DataUidMap data_uid_map(tensors.size());
+void XLATensor::ApplyPendingGraph(
+    const std::vector<std::shared_ptr<XLATensor>>& tensors,
+    ApplyContext* apply_context) {
+  if (AsyncApply()) {
+    RunAsyncApply(tensors, apply_context);
+  } else {
+    RunApply(tensors, apply_context, /*literals=*/nullptr);
+  }
+}
+
+void XLATensor::WaitForAsyncApply() {
+  // Failures are reported to the users of the apply results, through the
+  // placeholder data.
+  xla::Status status = AsyncApplyTracker::Get()->Wait();
+  if (!status.ok()) {
+    TF_VLOG(1) << "Asynchronous apply failed: " << status;
+  }
+}
+
+void XLATensor::RunAsyncApply(
+    const std::vector<std::shared_ptr<XLATensor>>& tensors,
+    ApplyContext* apply_context) {
+  std::shared_ptr<CachedApplyRun> cached_run;
+  if (apply_context != nullptr) {
+    // The apply context is owned by the caller, which updates it only with
+    // ApplyPendingGraph() calls, so waiting for the previous apply operation
+    // makes sure no one else is using it. The cached run inputs must be
+    // gathered before the tensors get their placeholders.
+    WaitForAsyncApply();
+    cached_run = std::make_shared<CachedApplyRun>();
+    if (!PrepareCachedApply(tensors, apply_context, cached_run.get())) {
+      XLA_COUNTER("UncachedApplyGraph", 1);
+      RunUncachedApply(tensors, apply_context, /*literals=*/nullptr,
+                       /*allow_donation=*/true);
+      return;
+    }
+    XLA_COUNTER("CachedApplyGraph", 1);
+  }
+  auto mwait = std::make_shared<xla::xla_util::MultiWait>(1);
+  AsyncApplyTracker::Get()->WaitAndSet(mwait);
+
+  // The background apply works on detached copies of the tensors, so that the
+  // caller is free to queue new operations on the original ones. Tensors with
+  // a pending graph get placeholder data which will be filled once the apply
+  // operation completes.
+  std::vector<std::shared_ptr<XLATensor>> detached_tensors;
+  std::vector<std::shared_ptr<AsyncXlaData>> placeholders(tensors.size());
+  detached_tensors.reserve(tensors.size());
   for (size_t i = 0; i < tensors.size(); ++i) {
-    auto& xla_data = tensors[i]->CurrentXlaData();
-    if (xla_data != nullptr) {
-      auto it_inserted =
-          data_uid_map.emplace(xla_data.get(), tensors[i]->GetUniqueId());
-      if (!it_inserted.second) {
-        // It can happen that two tensors references the same device data.
-        // This is due to ReferenceDataFrom() API calls, which we use to
-        // update the tensors (inputs, gradients,...) with the new data. In
-        // that case select the tensor with lower unique ID (older), as the
-        // newer one is very likely the new data provider which will be going
-        // away soon (as soon as the last tensor reference will go away).
-        it_inserted.first->second = std::min<xla::int64>(
-            it_inserted.first->second, tensors[i]->GetUniqueId());
-        XLA_COUNTER("DuplicatedTensorData", 1);
+    detached_tensors.push_back(std::make_shared<XLATensor>(
+        std::make_shared<Data>(*tensors[i]->data_)));
+    if (tensors[i]->CurrentIrNode() != nullptr) {
+      placeholders[i] = std::make_shared<AsyncXlaData>(
+          tensors[i]->GetDevice().ToString(), tensors[i]->shape(), mwait);
+      tensors[i]->SetXlaData(placeholders[i]);
+    }
+  }
+  // The tensors taking the device data passed through a donating cached apply
+  // get placeholders as well, as the device data they own is handed over to
+  // the execution.
+  if (cached_run != nullptr) {
+    for (auto& device_passthrough_owners : cached_run->passthrough_owners) {
+      for (auto& owners : device_passthrough_owners) {
+        for (auto& owner : owners) {
+          auto detached_owner = std::make_shared<XLATensor>(
+              std::make_shared<Data>(*owner->data_));
+          placeholders.push_back(std::make_shared<AsyncXlaData>(
+              owner->GetDevice().ToString(), owner->shape(), mwait));
+          owner->SetXlaData(placeholders.back());
+          detached_tensors.push_back(detached_owner);
+          owner = std::move(detached_owner);
+        }
+      }
+    }
+  }
+  XLA_COUNTER("AsyncApplyGraph", 1);
+
+  auto apply_fn = [detached_tensors, placeholders, cached_run]() mutable {
+    if (cached_run != nullptr) {
+      RunCachedApply(detached_tensors, *cached_run);
+    } else {
+      RunUncachedApply(detached_tensors, /*apply_context=*/nullptr,
+                       /*literals=*/nullptr, /*allow_donation=*/false);
+    }
+    for (size_t i = 0; i < placeholders.size(); ++i) {
+      if (placeholders[i] != nullptr) {
+        placeholders[i]->Set(detached_tensors[i]->CurrentXlaData());
       }
     }
+    // Drop the references to the device data and placeholders before the
+    // completion is signaled, so that the next apply can donate them.
+    detached_tensors.clear();
+    placeholders.clear();
+    cached_run = nullptr;
+  };
+  xla::xla_env::ScheduleIoClosure(mwait->Completer(std::move(apply_fn)));
+}
+
+void XLATensor::RunApply(const std::vector<std::shared_ptr<XLATensor>>& tensors,
+                         ApplyContext* apply_context,
+                         std::vector<xla::Literal>* literals) {
+  if (apply_context != nullptr) {
+    // Does it look like the cached context still applies to the new run?
+    CachedApplyRun cached_run;
+    if (literals == nullptr &&
+        PrepareCachedApply(tensors, apply_context, &cached_run)) {
+      XLA_COUNTER("CachedApplyGraph", 1);
+      RunCachedApply(tensors, cached_run);
+      return;
+    }
+    XLA_COUNTER("UncachedApplyGraph", 1);
   }
-  return data_uid_map;
+  RunUncachedApply(tensors, apply_context, literals, /*allow_donation=*/true);
 }
 
-void XLATensor::ApplyPendingGraph(
+void XLATensor::RunUncachedApply(
     const std::vector<std::shared_ptr<XLATensor>>& tensors,
-    ApplyContext* apply_context) {
+    ApplyContext* apply_context, std::vector<xla::Literal>* literals,
+    bool allow_donation) {
   struct DeviceContext {
-    DeviceContext() : xla_graph_ctx(/*collate_parameters=*/true) {}
+    DeviceContext() : lowering_ctx("ApplyPendingGraph") {}
 
-    XlaGraphContext xla_graph_ctx;
+    ir::LoweringContext lowering_ctx;
     std::vector<size_t> index_mapping;
+    ir::GraphFingerprint fingerprint;
+    DonationPlan donation_plan;
   };
 
   std::vector<size_t> order = GetApplyOrder(tensors);
@@ -825,17 +2390,8 @@ void XLATensor::ApplyPendingGraph(
   for (auto i : order) {
     uid_order.push_back(tensors[i]->GetUniqueId());
   }
-  DataUidMap data_uid_map;
-  if (apply_context != nullptr) {
-    // Does it look like the cached context still applies to the new run?
-    if (apply_context->uid_order == uid_order &&
-        RunCachedApply(tensors, *apply_context)) {
-      XLA_COUNTER("CachedApplyGraph", 1);
-      return;
-    }
-    XLA_COUNTER("UncachedApplyGraph", 1);
-    data_uid_map = CreateDataUidMap(tensors);
-  }
+  size_t uid_order_hash =
+      apply_context != nullptr ? GetUidOrderHash(uid_order) : 0;
 
   std::map<Device, DeviceContext> contexts_map;
   for (auto i : order) {
@@ -843,6 +2399,41 @@ void XLATensor::ApplyPendingGraph(
     device_context->index_mapping.push_back(i);
   }
 
+  // Check for donation before building the computations, as the graph
+  // contexts hold references to the parameters device data.
+  xla::xla_util::MultiWait mwait(contexts_map.size());
+  for (auto& device_and_context : contexts_map) {
+    DeviceContext* device_context = &device_and_context.second;
+    auto fingerprinter = [&, device_context]() {
+      std::vector<const ir::Node*> roots;
+      for (auto i : device_context->index_mapping) {
+        roots.push_back(tensors[i]->CurrentIrNode().get());
+      }
+      device_context->fingerprint = ir::ComputeGraphFingerprint(roots);
+      if (allow_donation && DonateInputBuffers()) {
+        device_context->donation_plan =
+            PlanDonation(tensors, device_context->index_mapping,
+                         device_context->fingerprint);
+      }
+    };
+    xla::xla_env::ScheduleClosure(mwait.Completer(std::move(fingerprinter)));
+  }
+  XLA_CHECK_OK(mwait.Wait());
+  // The XRT execution releases either all or none of the input handles, so
+  // donation happens only if all the parameters can be donated. Otherwise the
+  // computations must not alias their results to the parameters.
+  bool release_input_handles =
+      !contexts_map.empty() &&
+      std::all_of(contexts_map.begin(), contexts_map.end(),
+                  [](const std::pair<const Device, DeviceContext>& context) {
+                    return context.second.donation_plan.donate;
+                  });
+  if (!release_input_handles) {
+    for (auto& device_and_context : contexts_map) {
+      device_and_context.second.donation_plan = DonationPlan();
+    }
+  }
+
   std::atomic<size_t> unknown_params(0);
   std::vector<std::vector<xla::ComputationClient::Data*>> parameters(
       contexts_map.size());
@@ -850,82 +2441,196 @@ void XLATensor::ApplyPendingGraph(
   std::vector<std::vector<xla::int64>> index_mapping(contexts_map.size());
   std::vector<std::string> devices(contexts_map.size());
   std::vector<xla::Shape> shapes(contexts_map.size());
-  xla::xla_util::MultiWait mwait(contexts_map.size());
   std::vector<xla::ComputationClient::CompileInstance> instances(
       contexts_map.size());
+  std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
+      computations(contexts_map.size());
+  std::vector<tensorflow::Fprint128> cache_keys(contexts_map.size());
+  std::vector<std::vector<size_t>> parameters_mappings(contexts_map.size());
+  std::vector<std::vector<size_t>> parameters_uses(contexts_map.size());
+  std::vector<std::vector<size_t>> passthrough_params(contexts_map.size());
+  std::vector<std::vector<std::vector<std::shared_ptr<XLATensor>>>>
+      passthrough_owners(contexts_map.size());
+  std::vector<std::vector<ApplyContext::ScalarParameter>> scalar_parameters(
+      contexts_map.size());
+  std::vector<size_t> graph_hashes(contexts_map.size());
+  mwait.Reset(contexts_map.size());
   size_t index = 0;
   for (auto& device_and_context : contexts_map) {
     const Device& device = device_and_context.first;
     DeviceContext* device_context = &device_and_context.second;
 
     auto generator = [&, device_context, index]() {
+      const ir::GraphFingerprint& fingerprint = device_context->fingerprint;
+      const DonationPlan& donation_plan = device_context->donation_plan;
       std::vector<xla::int64> device_index_mapping;
+      std::vector<const xla::Shape*> result_shapes;
       for (auto i : device_context->index_mapping) {
-        auto& xla_graph_node = tensors[i]->CurrentXlaGraphNode();
-        auto root = xla_graph_node->Generate(&device_context->xla_graph_ctx);
-        device_context->xla_graph_ctx.AddResult(root);
         device_index_mapping.push_back(tensors[i]->GetUniqueId());
+        result_shapes.push_back(&tensors[i]->CurrentIrNode()->shape());
       }
       index_mapping[index] = std::move(device_index_mapping);
-
-      xla::XlaComputation computation =
-          device_context->xla_graph_ctx.Build().ConsumeValueOrDie();
-      xla::ProgramShape program_shape =
-          computation.GetProgramShape().ConsumeValueOrDie();
-      shapes[index] =
-          MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
       devices[index] = device.ToString();
-      instances[index] = {std::move(computation),
-                          std::vector<std::string>({devices[index]}),
-                          &shapes[index]};
 
-      std::vector<xla::ComputationClient::Data*> parameters_data =
-          device_context->xla_graph_ctx.GetParametersData();
+      cache_keys[index] = GetApplyCacheKey(fingerprint, devices[index],
+                                           /*tuple_result=*/true,
+                                           HashDonationPlan(donation_plan));
+      std::shared_ptr<CachedApplyComputation> cached_computation =
+          FindApplyComputation(cache_keys[index], fingerprint, result_shapes);
+      std::vector<xla::ComputationClient::Data*> parameters_data;
+      if (cached_computation != nullptr) {
+        computations[index] = cached_computation->computation;
+        parameters_mappings[index] = cached_computation->parameters_mapping;
+        parameters_data =
+            GetMappedParameters(fingerprint, parameters_mappings[index]);
+        passthrough_params[index] =
+            GetPassthroughParams(donation_plan, parameters_mappings[index]);
+      } else {
+        ir::LoweringContext* lowering_ctx = &device_context->lowering_ctx;
+        for (auto i : device_context->index_mapping) {
+          ir::Output root(tensors[i]->CurrentIrNode().get());
+          lowering_ctx->AddResult(lowering_ctx->GetOutputOp(root));
+        }
+        parameters_data = lowering_ctx->GetParametersData();
+        parameters_mappings[index] =
+            GetParametersMapping(fingerprint, parameters_data);
+        passthrough_params[index] =
+            GetPassthroughParams(donation_plan, parameters_mappings[index]);
+        if (donation_plan.donate) {
+          AddDonationResults(donation_plan, parameters_mappings[index],
+                             passthrough_params[index], result_shapes,
+                             parameters_data, lowering_ctx);
+        }
+        xla::XlaComputation computation =
+            lowering_ctx->Build().ConsumeValueOrDie();
+        xla::ProgramShape program_shape =
+            computation.GetProgramShape().ConsumeValueOrDie();
+        shapes[index] =
+            MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
+        instances[index] = {std::move(computation),
+                            std::vector<std::string>({devices[index]}),
+                            &shapes[index]};
+      }
+      for (auto param : passthrough_params[index]) {
+        passthrough_owners[index].push_back(
+            donation_plan.passthrough_owners.at(
+                parameters_mappings[index][param]));
+      }
       if (apply_context != nullptr) {
         std::vector<xla::int64> device_input_mapping;
-        for (auto data : parameters_data) {
-          auto it = data_uid_map.find(data);
-          if (it != data_uid_map.end()) {
-            device_input_mapping.push_back(it->second);
+        for (size_t param = 0; param < parameters_data.size(); ++param) {
+          xla::int64 uid;
+          ScalarDataKey scalar_key;
+          if (TensorsArena::Get()->GetDataUid(parameters_data[param], &uid)) {
+            device_input_mapping.push_back(uid);
+          } else if (ScalarDataIndex::Get()->Find(parameters_data[param],
+                                                  &scalar_key) != nullptr) {
+            scalar_parameters[index].push_back(
+                {param, parameters_mappings[index][param], scalar_key.type});
           } else {
             XLA_COUNTER("UnknownTensorData", 1);
             unknown_params += 1;
           }
         }
         input_mapping[index] = std::move(device_input_mapping);
+        graph_hashes[index] = fingerprint.hash;
+        for (auto position : parameters_mappings[index]) {
+          parameters_uses[index].push_back(
+              fingerprint.parameters_uses[position]);
+        }
       }
       parameters[index] = std::move(parameters_data);
     };
     xla::xla_env::ScheduleClosure(mwait.Completer(std::move(generator)));
     ++index;
   }
-  TF_CHECK_OK(mwait.Wait());
-
-  std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
-      computations;
-  if (!instances.empty()) {
-    computations = XlaGetClient()->Compile(std::move(instances));
+  XLA_CHECK_OK(mwait.Wait());
+
+  if (!contexts_map.empty()) {
+    // Compile only the computations which were not found in the cache.
+    std::vector<xla::ComputationClient::CompileInstance> compile_instances;
+    std::vector<size_t> compile_indices;
+    for (size_t i = 0; i < computations.size(); ++i) {
+      if (computations[i] == nullptr) {
+        compile_instances.push_back(std::move(instances[i]));
+        compile_indices.push_back(i);
+      }
+    }
+    if (!compile_instances.empty()) {
+      std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
+          compiled_computations =
+              XlaGetClient()->Compile(std::move(compile_instances));
+      for (size_t i = 0; i < compile_indices.size(); ++i) {
+        size_t computation_index = compile_indices[i];
+        computations[computation_index] = compiled_computations[i];
+        GetApplyComputationCache()->Add(
+            cache_keys[computation_index],
+            std::make_shared<CachedApplyComputation>(
+                compiled_computations[i],
+                std::move(parameters_mappings[computation_index])));
+      }
+    }
 
+    for (auto& device_parameters : parameters) {
+      ResolveParameters(&device_parameters);
+    }
     xla::ComputationClient::ExecuteParallelOptions options;
-    auto results = XlaGetClient()->ExecuteParallel(
-        xla::util::GetConstSharedPointers(computations), parameters, devices,
-        options);
+    options.release_input_handles = release_input_handles;
+    if (options.release_input_handles) {
+      XLA_COUNTER("DonatedApplyGraph", 1);
+    }
+    std::vector<std::vector<std::shared_ptr<xla::ComputationClient::Data>>>
+        results;
+    if (literals != nullptr) {
+      // Fetch the tensors tuple elements of all the computations, and store
+      // the literals following the tensors index mapping.
+      std::vector<std::vector<xla::int64>> fetch_indices;
+      for (auto& device_and_context : contexts_map) {
+        size_t num_results = device_and_context.second.index_mapping.size();
+        std::vector<xla::int64> computation_fetch_indices(num_results);
+        std::iota(computation_fetch_indices.begin(),
+                  computation_fetch_indices.end(), 0);
+        fetch_indices.push_back(std::move(computation_fetch_indices));
+      }
+      std::vector<std::vector<xla::Literal>> computations_literals;
+      results = XlaGetClient()->ExecuteParallelAndFetch(
+          xla::util::GetConstSharedPointers(computations), parameters, devices,
+          fetch_indices, &computations_literals, options);
+      auto context_iterator = contexts_map.begin();
+      for (auto& computation_literals : computations_literals) {
+        const auto& tensors_indices = context_iterator->second.index_mapping;
+        for (size_t i = 0; i < computation_literals.size(); ++i) {
+          (*literals)[tensors_indices[i]] = std::move(computation_literals[i]);
+        }
+        ++context_iterator;
+      }
+    } else {
+      results = XlaGetClient()->ExecuteParallel(
+          xla::util::GetConstSharedPointers(computations), parameters, devices,
+          options);
+    }
     auto context_iterator = contexts_map.begin();
+    size_t device_index = 0;
     for (auto& computation_tuple_elements : results) {
       // Replace destination's underlying data with the result of the
       // computation.
-      SetMulti(tensors, std::move(computation_tuple_elements),
-               context_iterator->second.index_mapping);
+      SetApplyResults(tensors, std::move(computation_tuple_elements),
+                      context_iterator->second.index_mapping,
+                      passthrough_owners[device_index]);
       ++context_iterator;
+      ++device_index;
     }
   }
   if (apply_context != nullptr) {
+    EraseApplyContextEntry(apply_context, uid_order_hash, uid_order);
     if (unknown_params == 0) {
-      *apply_context = {std::move(computations), std::move(uid_order),
-                        std::move(input_mapping), std::move(index_mapping),
-                        std::move(devices)};
-    } else {
-      *apply_context = ApplyContext();
+      AddApplyContextEntry(
+          apply_context,
+          {uid_order_hash, std::move(computations), std::move(uid_order),
+           std::move(input_mapping), std::move(index_mapping),
+           std::move(devices), release_input_handles,
+           std::move(parameters_uses), std::move(passthrough_params),
+           std::move(scalar_parameters), std::move(graph_hashes)});
     }
   }
 }
@@ -985,17 +2690,10 @@ xla::Literal GetTensorLiteral(const at::Tensor& tensor,
         XlaHelpers::MakeXlaPrimitiveType(tensor.type().scalarType()));
     shape = &computed_shape;
   }
-  switch (tensor.type().scalarType()) {
-    case at::ScalarType::Float:
-      if (shape->element_type() == xla::PrimitiveType::BF16) {
-        return TensorToLiteral<float, tensorflow::bfloat16>(tensor, *shape);
-      }
-      return TensorToLiteral<float, float>(tensor, *shape);
-    case at::ScalarType::Long:
-      return TensorToLiteral<int64_t, xla::int64>(tensor, *shape);
-    default:
-      TF_LOG(FATAL) << "Tensor type not supported";
-  }
+  xla::Literal literal(*shape);
+  PopulateTensorBuffer(tensor, *shape, literal.untyped_data(),
+                       literal.size_bytes());
+  return literal;
 }
 
 std::vector<xla::Shape> GetComponentShapes(const xla::Shape& shape) {
@@ -1,14 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
+#include <list>
 #include <string>
 #include <unordered_map>
 
-#include "graph_context.h"
+#include "ir.h"
 #include "tensorflow/cc/framework/ops.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "torch/csrc/autograd/variable.h"
 #include "torch/csrc/jit/ir.h"
 
@@ -52,15 +55,48 @@ class XLATensor {
   };
 
   // The context used by the ApplyPendingGraph() API, in order to allow it speed
-  // up operations in case the new tensors graph apply matches the one stored
-  // within the apply context.
+  // up operations in case the new tensors graph apply matches one of the ones
+  // stored within the apply context.
   struct ApplyContext {
-    std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
-        computations;
-    std::vector<xla::int64> uid_order;
-    std::vector<std::vector<xla::int64>> input_mapping;
-    std::vector<std::vector<xla::int64>> index_mapping;
-    std::vector<std::string> devices;
+    // A computation parameter fed with scalar device data (see the
+    // XLA_SCALARS_AS_PARAMETERS setting), which is not owned by any tensor.
+    struct ScalarParameter {
+      // The computation parameter number.
+      size_t param = 0;
+      // The position of the scalar device data within the fingerprint of the
+      // graphs the computation is generated from.
+      size_t position = 0;
+      xla::PrimitiveType type = xla::PrimitiveType::PRIMITIVE_TYPE_INVALID;
+    };
+
+    // The information about a single cached apply operation.
+    struct Entry {
+      size_t uid_order_hash = 0;
+      std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
+          computations;
+      std::vector<xla::int64> uid_order;
+      std::vector<std::vector<xla::int64>> input_mapping;
+      std::vector<std::vector<xla::int64>> index_mapping;
+      std::vector<std::string> devices;
+      // Whether the executions take over the input device data, in which case
+      // the computations alias their results to the parameters.
+      bool release_input_handles = false;
+      // Per computation, the number of graph nodes using each parameter, and
+      // the parameters passed through it, whose results follow the tensors
+      // ones.
+      std::vector<std::vector<size_t>> parameters_uses;
+      std::vector<std::vector<size_t>> passthrough_params;
+      // Per computation, the scalar parameters, which are not part of the
+      // input_mapping, and get gathered from the current graphs, as their
+      // values can change from one apply to the next. The graphs fingerprint
+      // hash must match the one in graph_hashes.
+      std::vector<std::vector<ScalarParameter>> scalar_parameters;
+      std::vector<size_t> graph_hashes;
+    };
+
+    // The cached apply operations, with the most recently used at the front.
+    // The number of entries is bounded by the XLA_APPLY_CONTEXT_SIZE setting.
+    std::list<Entry> entries;
   };
 
   static std::shared_ptr<XLATensor> Create(
@@ -68,8 +104,8 @@ class XLATensor {
   static std::shared_ptr<XLATensor> Create(
       std::shared_ptr<xla::ComputationClient::Data> xla_data,
       bool requires_grad);
-  static std::shared_ptr<XLATensor> Create(
-      std::shared_ptr<XlaGraphNode> xla_graph_node, const Device& device);
+  static std::shared_ptr<XLATensor> Create(ir::NodePtr ir_node,
+                                           const Device& device);
   static std::shared_ptr<XLATensor> Create(std::shared_ptr<Data> data);
 
   // NOTE: These direct constructors should not be used, and the Create() APIs
@@ -80,7 +116,7 @@ class XLATensor {
   XLATensor(const torch::autograd::Variable& tensor, const Device& device);
   XLATensor(std::shared_ptr<xla::ComputationClient::Data> xla_data,
             bool requires_grad);
-  XLATensor(std::shared_ptr<XlaGraphNode> xla_graph_node, const Device& device);
+  XLATensor(ir::NodePtr ir_node, const Device& device);
   XLATensor(std::shared_ptr<Data> data) : data_(std::move(data)) {}
 
   ~XLATensor();
@@ -113,8 +149,8 @@ class XLATensor {
 
   void SetXlaData(std::shared_ptr<xla::ComputationClient::Data> xla_data);
 
-  const std::shared_ptr<XlaGraphNode>& CurrentXlaGraphNode() const;
-  std::shared_ptr<XlaGraphNode> GetXlaGraphNode() const;
+  const ir::NodePtr& CurrentIrNode() const;
+  ir::NodePtr GetIrNode() const;
 
   // Makes the data references from the current tensor, point to the ones from
   // the source tensor.
@@ -167,28 +203,106 @@ class XLATensor {
   // Retrieves the set of XLA tensors which are currently live in the system.
   static std::vector<std::shared_ptr<XLATensor>> GetLiveTensors();
 
+  // Retrieves the live XLA tensors which have a pending graph, on the given
+  // device, or on all devices if device is nullptr. The cost of the call is
+  // proportional to the number of tensors with pending graphs.
+  static std::vector<std::shared_ptr<XLATensor>> GetPendingTensors(
+      const Device* device);
+
   // Applies the queue of operations for a list of tensors. The context of the
   // apply operation will be saved within the apply_context pointer, if not
   // nullptr. The ApplyPendingGraph() API will try to guess whether the current
   // apply operation matches the previously cached one in apply_context, and
   // eventually uses the cached XLA compiled computations to run the apply.
+  // When XLA_ASYNC_APPLY is enabled, the API returns as soon as the tensors
+  // have been assigned placeholder data, which gets waited for only when the
+  // device data is actually needed (like in GetXlaData()).
   static void ApplyPendingGraph(
       const std::vector<std::shared_ptr<XLATensor>>& tensors,
       ApplyContext* apply_context);
 
+  // Waits for the asynchronous apply operations started by ApplyPendingGraph()
+  // to complete. The owners of an ApplyContext must call it before destroying
+  // the context, which the background apply might still be using.
+  static void WaitForAsyncApply();
+
   // Retrieves the PyTorch tensors behind the XLA tensors.
   static std::vector<at::Tensor> GetTensors(
       const std::vector<std::shared_ptr<XLATensor>>& tensors);
 
+  // The PyTorch tensors being fetched in background by GetTensorsAsync().
+  class TensorsFetch {
+   public:
+    // Returns whether the fetch has completed, without blocking.
+    bool IsReady() const { return ready_; }
+
+    // Waits for the fetch to complete, and returns the PyTorch tensors.
+    std::vector<at::Tensor> Wait();
+
+   private:
+    friend class XLATensor;
+
+    xla::xla_util::MultiWait mwait_{1};
+    std::atomic<bool> ready_{false};
+    std::vector<at::Tensor> results_;
+  };
+
+  // Like GetTensors(), but returns as soon as the device data reads have been
+  // queued on the IO thread pool. The tensors with a pending graph get it
+  // applied in background (see RunAsyncApply()), so the caller is free to
+  // queue new operations on all the tensors while the fetch is in flight.
+  static std::shared_ptr<TensorsFetch> GetTensorsAsync(
+      const std::vector<std::shared_ptr<XLATensor>>& tensors);
+
+  // Creates XLA tensors out of autograd variables, converting each of them only
+  // once, and uploading it to all the devices. The returned result[i][j] is
+  // tensors[i] on devices[j]. All the devices must have the same type.
+  static std::vector<std::vector<std::shared_ptr<XLATensor>>> BroadcastTensors(
+      const std::vector<torch::autograd::Variable>& tensors,
+      const std::vector<Device>& devices);
+
+  // Copies the tensors to other devices, with tensors[i] going to devices[i].
+  // The device data moves between the devices within the servers, without
+  // going through the local host. The pending graphs of the tensors get
+  // applied first.
+  static std::vector<std::shared_ptr<XLATensor>> TransferTensors(
+      const std::vector<std::shared_ptr<XLATensor>>& tensors,
+      const std::vector<Device>& devices);
+
+  // Describes the on-device conversion of a tensor created by CreateTensors().
+  // The tensor is transferred with its own (possibly narrow) element type, and
+  // the conversion becomes the first operation of its pending graph:
+  //   result = convert(tensor, type) * scale + offset
+  struct DeviceCast {
+    at::ScalarType type = at::ScalarType::Float;
+    double scale = 1.0;
+    double offset = 0.0;
+  };
+
   // Operation which creates XLA tensors out of autograd variable by batching
-  // the requests to the computation servers.
+  // the requests to the computation servers. If device_casts is not nullptr,
+  // the tensors[i] for which (*device_casts)[i] is set get converted on device
+  // as described by it.
   static std::vector<std::shared_ptr<XLATensor>> CreateTensors(
       const std::vector<torch::autograd::Variable>& tensors,
-      const std::vector<std::string>& devices);
+      const std::vector<std::string>& devices,
+      const std::vector<c10::optional<DeviceCast>>* device_casts);
 
  private:
-  using DataUidMap =
-      std::unordered_map<xla::ComputationClient::Data*, xla::int64>;
+  // The computations and device data of a cached apply operation, gathered by
+  // PrepareCachedApply() and run by RunCachedApply().
+  struct CachedApplyRun {
+    std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
+        computations;
+    std::vector<std::vector<std::shared_ptr<xla::ComputationClient::Data>>>
+        parameters;
+    std::vector<std::vector<size_t>> index_mapping;
+    std::vector<std::string> devices;
+    // Per computation, the tensors taking the device data passed through it.
+    std::vector<std::vector<std::vector<std::shared_ptr<XLATensor>>>>
+        passthrough_owners;
+    bool release_input_handles = false;
+  };
 
   struct Data {
     Data(std::shared_ptr<xla::ComputationClient::Data> xla_data,
@@ -196,45 +310,87 @@ class XLATensor {
         : xla_data(std::move(xla_data)),
           device(device),
           unique_id(GetNextTensorId()) {}
-    Data(std::shared_ptr<XlaGraphNode> xla_graph_node, const Device& device)
-        : xla_graph_node(std::move(xla_graph_node)),
+    Data(ir::NodePtr ir_node, const Device& device)
+        : ir_node(std::move(ir_node)),
           device(device),
           unique_id(GetNextTensorId()) {}
 
     std::shared_ptr<xla::ComputationClient::Data> xla_data;
-    std::shared_ptr<XlaGraphNode> xla_graph_node;
+    ir::NodePtr ir_node;
     Device device;
     xla::int64 unique_id;
     std::shared_ptr<XLATensor> grad;
   };
 
-  void SetXlaGraphNode(std::shared_ptr<XlaGraphNode> xla_graph_node);
+  void SetIrNode(ir::NodePtr ir_node);
 
   // We build an XLA graph accumulating XLA operations, but at a given point we
   // need to force a rendering, otherwise the graph can grow without control.
   // Think:
   //   for i in range(0, 100000):
   //     a = a + b
+  // The graph is cut once it exceeds one of the limits set by the
+  // XLA_MAX_PENDING_GRAPH_SIZE (unique nodes), XLA_MAX_PENDING_GRAPH_COST
+  // (estimated computation cost) and XLA_MAX_PENDING_GRAPH_BYTES (device data
+  // bytes kept alive) settings, in which case all the tensors with a pending
+  // graph on the same device get applied together.
   void TryLimitGraphSize();
 
-  std::shared_ptr<XlaGraphNode> CreateAddNode(const XLATensor& other,
-                                              const at::Scalar& alpha);
-  std::shared_ptr<XlaGraphNode> CreateMulNode(const XLATensor& other);
-  std::shared_ptr<XlaGraphNode> CreateMulNode(const at::Scalar& other);
-  std::shared_ptr<XlaGraphNode> CreateDivNode(const XLATensor& other);
-  std::shared_ptr<XlaGraphNode> CreateDivNode(const at::Scalar& other);
-
-  // Create the mapping from computation client Data pointers to the XLA tensors
-  // unique ID which are holding it.
-  static DataUidMap CreateDataUidMap(
-      const std::vector<std::shared_ptr<XLATensor>>& tensors);
+  ir::NodePtr CreateAddNode(const XLATensor& other, const at::Scalar& alpha);
+  ir::NodePtr CreateMulNode(const XLATensor& other);
+  ir::NodePtr CreateMulNode(const at::Scalar& other);
+  ir::NodePtr CreateDivNode(const XLATensor& other);
+  ir::NodePtr CreateDivNode(const at::Scalar& other);
+
+  // Creates the graph node for a scalar operand with the given type. Depending
+  // on the XLA_SCALARS_AS_PARAMETERS setting, the scalar will either be a
+  // constant within the computation, or device data fed as parameter.
+  ir::NodePtr CreateScalarNode(const at::Scalar& value,
+                               xla::PrimitiveType type) const;
+
+  // Looks up the apply_context entry matching the tensors with a pending
+  // graph, and gathers the current device data of the tensors feeding its
+  // computations. Returns whether the cached information still applies, in
+  // which case run is filled up for RunCachedApply().
+  static bool PrepareCachedApply(
+      const std::vector<std::shared_ptr<XLATensor>>& tensors,
+      ApplyContext* apply_context, CachedApplyRun* run);
 
-  // Tries to run a cached ApplyPendingGraph() with the information in
-  // apply_context. Returns whether the cached run could be completed
-  // successfully.
-  static bool RunCachedApply(
+  // Runs the cached apply operation prepared by PrepareCachedApply() for the
+  // same tensors.
+  static void RunCachedApply(
+      const std::vector<std::shared_ptr<XLATensor>>& tensors,
+      const CachedApplyRun& run);
+
+  // Runs the pending graph of this tensor, if any. If literal is not nullptr,
+  // the result is also fetched to host within the same execution. Returns
+  // whether a pending graph was run.
+  bool RunPendingGraph(xla::Literal* literal);
+
+  // Runs the apply operation for the tensors, waiting for its completion. If
+  // literals is not nullptr, (*literals)[i] receives the host value of the
+  // tensors[i] result, for the tensors which had a pending graph.
+  static void RunApply(const std::vector<std::shared_ptr<XLATensor>>& tensors,
+                       ApplyContext* apply_context,
+                       std::vector<xla::Literal>* literals);
+
+  // Like RunApply(), but without looking up apply_context, which only gets
+  // the new entry for the apply operation. The input device data is handed
+  // over to the execution only if allow_donation is true, which requires the
+  // tensors to be the ones tracked by the tensors arena.
+  static void RunUncachedApply(
       const std::vector<std::shared_ptr<XLATensor>>& tensors,
-      const ApplyContext& apply_context);
+      ApplyContext* apply_context, std::vector<xla::Literal>* literals,
+      bool allow_donation);
+
+  // Runs the apply operation in background, after having set placeholder data
+  // on the tensors with a pending graph. The apply_context, if not nullptr,
+  // must be kept alive until the apply completes (see WaitForAsyncApply()).
+  // Apply operations not found within apply_context run synchronously, as the
+  // new entry needs a stable view of the tensors owning the device data.
+  static void RunAsyncApply(
+      const std::vector<std::shared_ptr<XLATensor>>& tensors,
+      ApplyContext* apply_context);
 
   // Returns a permutation which represents an ordering by tensor device and
   // unique ID, of all the tensors which needs sync (the ones which have a graph
@@ -243,9 +399,15 @@ class XLATensor {
   static std::vector<size_t> GetApplyOrder(
       const std::vector<std::shared_ptr<XLATensor>>& tensors);
 
-  static std::shared_ptr<XlaGraphNode> CreateTensorNode(
+  static ir::NodePtr CreateTensorNode(
       std::shared_ptr<xla::ComputationClient::Data> data);
 
+  // Creates a tensor whose pending graph applies the device_cast conversion
+  // to the data.
+  static std::shared_ptr<XLATensor> CreateDeviceCastTensor(
+      std::shared_ptr<xla::ComputationClient::Data> data,
+      const DeviceCast& device_cast, bool requires_grad);
+
   static xla::int64 GetNextTensorId();
 
   std::shared_ptr<Data> data_;
@@ -564,14 +564,16 @@ class XlaModel(object):
   def parameters_buffers_list(self):
     return xu.flatten_nested_tuple(self.parameters_buffers())
 
-  def _compute_loss(self, xla_outputs):
+  def _fetch_losses(self, xla_outputs):
     xla_losses = []
     for _, replica_xla_outputs in enumerate(xla_outputs):
       # The loss is ordinal 0 of the model returned tuple (original model
       # output is ordinal 1).
       xla_losses.append(replica_xla_outputs[0])
+    return torch_xla._XLAC._xla_to_tensors_async(xla_losses)
 
-    losses = torch_xla._XLAC._xla_to_tensors(xla_losses)
+  def _compute_loss(self, losses_fetch):
+    losses = losses_fetch.wait()
     loss = 0.0
     for closs in losses:
       loss += closs.sum().item()
@@ -596,6 +598,19 @@ class XlaModel(object):
     loss = None
     rate_tracker = RateTracker()
     self._epoch += 1
+    # The losses of a logged step are fetched in background, and reported
+    # after the following step has been queued, so that the fetch does not
+    # stall the training loop.
+    pending_log = None
+
+    def flush_log():
+      losses_fetch, batch_number, rate, step = pending_log
+      loss = self._compute_loss(losses_fetch)
+      log_fn(
+          TrainStepMetrics(self._epoch, self._num_cores, batch_number,
+                           len(samples_loader), batch_size, loss, rate, step))
+      return loss
+
     for batch_number, (inputs, targets) in wloader:
       self._step += 1
       xla_outputs = xla_run_model(
@@ -605,16 +620,18 @@ class XlaModel(object):
           self._get_backward_grads(xla_outputs),
           devices=self._devices)
       optimizer.step()
+      if pending_log is not None:
+        loss = flush_log()
+        pending_log = None
       if (log_fn is not None and log_interval is not None and
           batch_number % log_interval == 0):
         if metrics_debug:
           log_fn(torch_xla._XLAC._xla_metrics_report())
-        loss = self._compute_loss(xla_outputs)
         rate_tracker.update(self._num_cores * batch_size * (batch_number + 1))
-        log_fn(
-            TrainStepMetrics(self._epoch, self._num_cores, batch_number,
-                             len(samples_loader), batch_size, loss,
-                             rate_tracker.rate(), self._step))
+        pending_log = (self._fetch_losses(xla_outputs), batch_number,
+                       rate_tracker.rate(), self._step)
+    if pending_log is not None:
+      loss = flush_log()
     return loss
 
   def test(self, samples_loader, eval_fn, batch_size, log_fn=print):